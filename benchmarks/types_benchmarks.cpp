@@ -0,0 +1,295 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <types.hpp>
+#include <buffer.hpp>
+#include <json_writer.hpp>
+
+// Run with `--benchmark_format=json --benchmark_out=<file>` to get
+// results that could be compared between releases
+
+namespace {
+
+const std::vector<int64_t> TableSizes = {10, 100, 1000, 10000, 100000, 1000000};
+
+Member MakeMember(size_t i, uint32_t incarnation = 0) {
+    // Distinct address for every index, 10.0.0.0/8 with a few ports
+    return Member{MemberAddr{boost::asio::ip::address_v4{0x0A000000u + static_cast<uint32_t>(i >> 2)},
+                             static_cast<uint16_t>(8000 + (i & 3))},
+                  MemberInfo{MemberInfo::State::Alive, incarnation, TimeStamp{0}}};
+}
+
+// Tables are built once per size and shared by all benchmarks
+const MemberTable& Table(size_t size) {
+    static std::map<size_t, MemberTable> tables;
+
+    auto found = tables.find(size);
+    if (found != tables.end())
+        return found->second;
+
+    MemberTable& table = tables[size];
+    for (size_t i = 0; i < size; ++i)
+        table.UpdateRecordIfNewer(MakeMember(i, 1));
+
+    return table;
+}
+
+Gossip MakeGossip(size_t tableSize) {
+    Gossip gossip{};
+    gossip.TTL = 3;
+    gossip.Owner = MakeMember(0, 1);
+    gossip.Dest = MakeMember(1, 1);
+    gossip.Table = Table(tableSize);
+
+    return gossip;
+}
+
+void TableSizesArgs(benchmark::internal::Benchmark* bench) {
+    for (auto size : TableSizes)
+        bench->Arg(size);
+}
+
+// {table size, % of newer records, % of stale ones}, the rest are equal
+void UpdateArgs(benchmark::internal::Benchmark* bench) {
+    const std::vector<std::pair<int64_t, int64_t>> ratios = {{0, 0}, {100, 0}, {0, 100}, {50, 25}};
+
+    for (auto size : TableSizes) {
+        for (const auto& ratio : ratios)
+            bench->Args({size, ratio.first, ratio.second});
+    }
+}
+
+} // namespace
+
+
+static void BM_GossipWrite(benchmark::State& state, WireVersion version) {
+    Gossip gossip = MakeGossip(state.range(0));
+    ByteBuffer buffer{gossip.ByteSize(version)};
+
+    for (auto _ : state) {
+        byte* end = gossip.Write(buffer.Begin(), buffer.End(), version);
+        benchmark::DoNotOptimize(end);
+    }
+
+    state.SetBytesProcessed(state.iterations() * gossip.ByteSize(version));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_GossipWrite, v1, WireVersion::V1)->Apply(TableSizesArgs);
+BENCHMARK_CAPTURE(BM_GossipWrite, v2, WireVersion::V2)->Apply(TableSizesArgs);
+
+static void BM_GossipRead(benchmark::State& state, WireVersion version) {
+    Gossip gossip = MakeGossip(state.range(0));
+    ByteBuffer buffer{gossip.ByteSize(version)};
+    const byte* end = gossip.Write(buffer.Begin(), buffer.End(), version);
+
+    for (auto _ : state) {
+        Gossip read{};
+        benchmark::DoNotOptimize(read.Read(buffer.Begin(), end));
+    }
+
+    state.SetBytesProcessed(state.iterations() * (end - buffer.Begin()));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_GossipRead, v1, WireVersion::V1)->Apply(TableSizesArgs);
+BENCHMARK_CAPTURE(BM_GossipRead, v2, WireVersion::V2)->Apply(TableSizesArgs);
+
+static void BM_GossipViewParse(benchmark::State& state, WireVersion version) {
+    Gossip gossip = MakeGossip(state.range(0));
+    ByteBuffer buffer{gossip.ByteSize(version)};
+    const byte* end = gossip.Write(buffer.Begin(), buffer.End(), version);
+
+    for (auto _ : state) {
+        GossipView view;
+        benchmark::DoNotOptimize(view.Parse(buffer.Begin(), end));
+    }
+
+    state.SetBytesProcessed(state.iterations() * (end - buffer.Begin()));
+}
+BENCHMARK_CAPTURE(BM_GossipViewParse, v1, WireVersion::V1)->Apply(TableSizesArgs);
+BENCHMARK_CAPTURE(BM_GossipViewParse, v2, WireVersion::V2)->Apply(TableSizesArgs);
+
+static void BM_MemberTableWrite(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+    ByteBuffer buffer{table.ByteSize()};
+
+    for (auto _ : state) {
+        byte* end = table.Write(buffer.Begin(), buffer.End());
+        benchmark::DoNotOptimize(end);
+    }
+
+    state.SetBytesProcessed(state.iterations() * table.ByteSize());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemberTableWrite)->Apply(TableSizesArgs);
+
+// The bound of `BM_MemberTableWrite`: copying the same bytes at once
+static void BM_MemberTableMemcpy(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+    ByteBuffer source{table.ByteSize()};
+    ByteBuffer buffer{table.ByteSize()};
+    table.Write(source.Begin(), source.End());
+
+    for (auto _ : state) {
+        std::memcpy(buffer.Begin(), source.Begin(), source.Size());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * table.ByteSize());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemberTableMemcpy)->Apply(TableSizesArgs);
+
+static void BM_MemberTableRead(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+    ByteBuffer buffer{table.ByteSize()};
+    table.Write(buffer.Begin(), buffer.End());
+
+    for (auto _ : state) {
+        MemberTable read;
+        benchmark::DoNotOptimize(read.Read(buffer.Begin(), buffer.End()));
+    }
+
+    state.SetBytesProcessed(state.iterations() * table.ByteSize());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemberTableRead)->Apply(TableSizesArgs);
+
+// Merges datagram-sized gossips about members of a big table, each one
+// about the next window of the table. Newer records override local
+// ones, stale ones are reported as conflicts, the rest are equal
+static void BM_MemberTableUpdate(benchmark::State& state) {
+    const size_t gossipSize = 64;
+
+    MemberTable table = Table(state.range(0));
+    size_t count = std::min<size_t>(table.Size(), gossipSize);
+    size_t newer = count * state.range(1) / 100;
+    size_t stale = count * state.range(2) / 100;
+
+    Gossip gossip = MakeGossip(0);
+    std::deque<Conflict> conflicts;
+    size_t window = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        gossip.Table = MemberTable{};
+        for (size_t i = 0; i < count; ++i) {
+            Member record = *table.Find(MakeMember((window + i) % table.Size()).Addr);
+            if (i < newer)
+                ++record.Info.Incarnation;
+            else if (i < newer + stale)
+                record.Info.Incarnation = 0;
+            gossip.Table.UpdateRecordIfNewer(record);
+        }
+        window = (window + count) % table.Size();
+        conflicts.clear();
+        state.ResumeTiming();
+
+        table.Update(gossip, conflicts);
+    }
+
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_MemberTableUpdate)->Apply(UpdateArgs);
+
+// Merges a drain of `range(1)` re-forwarded gossips about the same 64
+// members, one by one or through `MergeBatch`. Every gossip carries
+// newer records than the previous one, as with refutations racing
+// suspicions, so merging one by one changes each record every time
+static void BM_MergeDrain(benchmark::State& state, bool coalesce) {
+    const size_t gossipSize = 64;
+
+    MemberTable table = Table(state.range(0));
+    size_t count = std::min<size_t>(table.Size(), gossipSize);
+    std::deque<Gossip> drain(state.range(1), MakeGossip(0));
+    MergeBatch batch;
+    std::deque<Conflict> conflicts;
+    size_t window = 0;
+    uint32_t incarnation = 1;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& gossip : drain) {
+            ++incarnation;
+            gossip.Table.Clear();
+            for (size_t i = 0; i < count; ++i)
+                gossip.Table.UpdateRecordIfNewer(MakeMember((window + i) % table.Size(), incarnation));
+        }
+        window = (window + count) % table.Size();
+        conflicts.clear();
+        state.ResumeTiming();
+
+        if (coalesce) {
+            batch.Clear();
+            for (const auto& gossip : drain)
+                batch.Add(table, gossip, conflicts);
+            batch.Apply(table);
+        } else {
+            for (const auto& gossip : drain)
+                table.Update(gossip, conflicts);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * count * drain.size());
+}
+BENCHMARK_CAPTURE(BM_MergeDrain, sequential, false)->ArgsProduct({{10000, 1000000}, {1, 8, 32}});
+BENCHMARK_CAPTURE(BM_MergeDrain, coalesced, true)->ArgsProduct({{10000, 1000000}, {1, 8, 32}});
+
+static void BM_GetSubset(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.GetSubset(10));
+    }
+}
+BENCHMARK(BM_GetSubset)->Apply(TableSizesArgs);
+
+static void BM_Sample(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+    std::vector<Member> out(10);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.Sample(out.data(), out.size()));
+    }
+}
+BENCHMARK(BM_Sample)->Apply(TableSizesArgs);
+
+static void BM_RandomMember(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.RandomMember());
+    }
+}
+BENCHMARK(BM_RandomMember)->Apply(TableSizesArgs);
+
+static void BM_MemberTableToJSON(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.ToJSON().dump());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemberTableToJSON)->Apply(TableSizesArgs);
+
+// Cached fragments, nothing changes between exports
+static void BM_MemberTableJSONCached(benchmark::State& state) {
+    const MemberTable& table = Table(state.range(0));
+    MemberTableJSON tableJSON;
+    tableJSON.Dump(table);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tableJSON.Dump(table).data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MemberTableJSONCached)->Apply(TableSizesArgs);
+
+BENCHMARK_MAIN();
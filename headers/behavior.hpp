@@ -6,30 +6,83 @@
 #include <stdexcept>
 #include <thread>
 #include <deque>
+#include <vector>
 #include <iostream>
-#include <mutex>
 
 #include <boost/asio.hpp>
 
 #include <types.hpp>
 #include <buffer.hpp>
+#include <network.hpp>
+#include <packer.hpp>
+#include <metrics.hpp>
+#include <queue.hpp>
+#include <scheduler.hpp>
 
-class ThreadSaveGossipQueue {
-private:
-    std::deque<Gossip> queue_;
-    std::mutex mutex_;
+// Received datagram validated once by the receiving thread.
+// `View` points into `Bytes`, which keep their storage when moved.
+// The bytes are a slot of the packet pool, returned when the packet
+// is destroyed
+struct Packet {
+    ByteBuffer Bytes;
+    GossipView View;
+    boost::asio::ip::udp::endpoint Sender;
 
-public:
-    void Push(const Gossip& gossip);
-    std::deque<Gossip> Free();
+    Packet() = default;
+    Packet(Packet&&) = default;
+    Packet& operator=(Packet&&) = default;
+
+    Packet(const Packet&) = delete;
+    Packet& operator=(const Packet&) = delete;
+};
+
+// Filled by receiving threads, drained by the main loop
+using PacketQueue = MPSCQueue<Packet>;
+
+// Hot path metrics of the daemon, all registered in one registry
+struct DaemonMetrics {
+    // Receiving threads
+    MetricsRegistry::Counter& ReceiveCalls;
+    MetricsRegistry::Counter& ReceivedDatagrams;
+    MetricsRegistry::Counter& ReceivedBytes;
+    MetricsRegistry::Counter& InvalidDatagrams;     // truncated or unparsable
+    // Protocol rounds
+    MetricsRegistry::Counter& Rounds;
+    MetricsRegistry::Counter& Conflicts;
+    MetricsRegistry::Counter& CoalescedRecords;     // duplicates dropped by merges
+    MetricsRegistry::Counter& SentDatagrams;
+    MetricsRegistry::Counter& SentBytes;
+    MetricsRegistry::Histogram& MergeLatency;
+    MetricsRegistry::Histogram& GenerateLatency;
+    MetricsRegistry::Histogram& SendLatency;
+    MetricsRegistry::Histogram& RoundLatency;
+
+    explicit DaemonMetrics(MetricsRegistry& registry);
 };
 
 boost::asio::ip::udp::socket SetupSocket(boost::asio::io_service& ioService, uint16_t port);
-void GossipsCatching(boost::asio::ip::udp::socket& sock, ThreadSaveGossipQueue& queue);
-std::deque<Conflict> UpdateTable(MemberTable& table, const std::deque<Gossip>& queue);
-std::deque<Gossip> GenerateGossips(MemberTable& table, std::deque<Gossip>& queue); // TODO: complete it
+// `count` sockets on the same port with `SO_REUSEPORT`, kernel spreads
+// senders between them, so every one can be read by its own thread
+std::vector<boost::asio::ip::udp::socket> SetupSockets(boost::asio::io_service& ioService, uint16_t port,
+                                                       size_t count);
+// Wakes scheduler after every received batch. Datagrams are copied into
+// buffers of `pool`, the ones arriving while it's exhausted are dropped
+void GossipsCatching(boost::asio::ip::udp::socket& sock, PacketQueue& queue, ProtocolScheduler& scheduler,
+                     BufferPool& pool, size_t batchSize, DaemonMetrics& metrics);
+// Merges all packets through `batch` (see `MergeBatch`) and appends to
+// `conflicts`, so the caller can keep reusing both. Returns the number
+// of records coalesced away
+size_t UpdateTable(MemberTable& table, const std::vector<Packet>& packets, MergeBatch& batch,
+                   std::deque<Conflict>& conflicts);
+// Forwards gossips with TTL left, packer fills them up to MTU. Appends
+// to `out`, cleared batches are refilled without allocations
+void GenerateGossips(MemberTable& table, GossipPacker& packer, const std::vector<Packet>& packets, GossipBatch& out);
 void SendGossip(boost::asio::ip::udp::socket&, const Gossip& gossip);
-
-void AppConnector(const MemberTable& table);
+// Serializes all gossips into sender's arena and flushes them with a few
+// syscalls. Returns the number of bytes sent
+size_t SendGossips(boost::asio::ip::udp::socket& sock, DatagramSender& sender, const std::deque<Gossip>& gossips,
+                   WireVersion version = WireVersion::V1);
+size_t SendGossips(boost::asio::ip::udp::socket& sock, DatagramSender& sender, const GossipBatch& gossips,
+                   WireVersion version = WireVersion::V1);
 
 #endif // HEADERS_BEHAVIOR_HPP_
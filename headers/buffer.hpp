@@ -3,19 +3,36 @@
 #ifndef HEADERS_BUFFER_HPP_
 #define HEADERS_BUFFER_HPP_
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 
 using byte = uint8_t;
 
+class BufferPool;
+
+// Owns its bytes: either allocated by itself or a slot taken from
+// a `BufferPool`, which gets the slot back when the buffer is destroyed.
+// Moving keeps the storage, so pointers into it stay valid
 class ByteBuffer {
 private:
     byte* buffer_;
     std::size_t size_;
+    BufferPool* pool_;
 
 public:
+    // Owns nothing
+    ByteBuffer();
     explicit ByteBuffer(std::size_t size);
     ~ByteBuffer();
 
+    ByteBuffer(ByteBuffer&& other) noexcept;
+    ByteBuffer& operator=(ByteBuffer&& other) noexcept;
+
+    ByteBuffer(const ByteBuffer&) = delete;
+    ByteBuffer& operator=(const ByteBuffer&) = delete;
+
     const byte* Begin() const;
     byte* Begin();
 
@@ -23,6 +40,69 @@ public:
     byte* End();
 
     std::size_t Size() const;
+    // Owns no storage, e.g. the pool was exhausted
+    bool Empty() const;
+    // Leaves only the first `size` bytes, the storage is kept until release
+    void Shrink(std::size_t size);
+
+private:
+    friend class BufferPool;
+    ByteBuffer(byte* buffer, std::size_t size, BufferPool* pool);
+
+    void Release();
+};
+
+
+/* BufferPool
+ * |
+ * |__Slab (byte[SlotSize * SlotsCount]) -> allocated once
+ * |  |___________________________________________
+ * |  | Slot[0] | Slot[1] |  .......  | Slot[n-1] |
+ * |  |___________________________________________
+ * |
+ * |__Next (atomic<uint32_t>[n])  -> free slot following each free one
+ * |__Head (atomic<uint64_t>)     -> pops (32 bits), first free slot (32 bits)
+ *
+ * Lock-free stack of free slots: taking and returning one is a single
+ * CAS on `Head`, any thread may do both. The pop counter makes a slot
+ * taken and returned between load and CAS change `Head` anyway (ABA).
+ * An exhausted pool hands out empty buffers instead of allocating.
+ * Buffers must be released before the pool is destroyed
+ * */
+
+class BufferPool {
+private:
+    static constexpr std::size_t CacheLine = 64;
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    std::unique_ptr<byte[]> slab_;
+    std::size_t slotSize_;
+    std::size_t slotsCount_;
+    std::unique_ptr<std::atomic<uint32_t>[]> next_;
+
+    alignas(CacheLine) std::atomic<uint64_t> head_;
+    alignas(CacheLine) std::atomic<std::size_t> available_;
+    std::atomic<std::size_t> exhausted_;
+
+public:
+    BufferPool(std::size_t slotSize, std::size_t slotsCount);
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Buffer of `SlotSize()` bytes, empty if every slot is taken
+    ByteBuffer Acquire();
+
+    std::size_t SlotSize() const;
+    std::size_t Capacity() const;
+    // Approximate number of free slots
+    std::size_t Available() const;
+    // `Acquire()` calls that found no free slot
+    std::size_t Exhausted() const;
+
+private:
+    friend class ByteBuffer;
+    void Release(byte* buffer);
 };
 
 #endif // HEADERS_BUFFER_HPP_
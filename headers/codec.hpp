@@ -0,0 +1,176 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_CODEC_HPP_
+#define HEADERS_CODEC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+using byte = uint8_t;
+
+
+/* Compile-time codec of fixed-size records (v1 encoding)
+ *
+ * A record type lists its fields once, in wire order:
+ *
+ *   template <>
+ *   struct Layout<MemberInfo> : Fields<Field<&MemberInfo::Status>,
+ *                                      Field<&MemberInfo::Incarnation>,
+ *                                      Field<&MemberInfo::LastUpdate>> {};
+ *
+ * A field of a type with its own layout is encoded by that layout,
+ * a trivially copyable one as it is in memory (host order), any other
+ * type needs a specialization of `Codec`. Record sizes are constants,
+ * stores and loads are unchecked `memcpy`s at constant offsets which
+ * the compiler merges into a few moves. Bounds are checked once per
+ * record or per array of them by `WriteRecord(s)`/`ReadRecord(s)`,
+ * which also reject records with a field out of its `Codec::Valid`
+ * range (e.g. an unknown enumerator). `Valid` looks at the encoded
+ * bytes, so an out-of-range value is never loaded into its type
+ * */
+
+template < typename Record >
+struct Layout {
+    static constexpr bool Declared = false;
+};
+
+// Encoding of a single value, see above
+template < typename Type, typename Enable = void >
+struct Codec {
+    static_assert(std::is_trivially_copyable<Type>::value, "Type needs a Layout or a Codec specialization");
+
+    static constexpr size_t Size = sizeof(Type);
+
+    static void Store(byte* out, const Type& value) {
+        std::memcpy(out, &value, sizeof(Type));
+    }
+
+    static void Load(const byte* in, Type& value) {
+        std::memcpy(&value, in, sizeof(Type));
+    }
+
+    static bool Valid(const byte*) {
+        return true;
+    }
+};
+
+template < typename Type >
+struct Codec<Type, std::enable_if_t<Layout<Type>::Declared>> : Layout<Type> {};
+
+template < auto Pointer >
+struct Field;
+
+template < typename Record, typename Type, Type Record::*Pointer >
+struct Field<Pointer> {
+    static constexpr size_t Size = Codec<Type>::Size;
+
+    static void Store(byte* out, const Record& record) {
+        Codec<Type>::Store(out, record.*Pointer);
+    }
+
+    static void Load(const byte* in, Record& record) {
+        Codec<Type>::Load(in, record.*Pointer);
+    }
+
+    static bool Valid(const byte* in) {
+        return Codec<Type>::Valid(in);
+    }
+};
+
+template < typename... Members >
+struct Fields {
+    static constexpr bool Declared = true;
+    static constexpr size_t Size = (Members::Size + ...);
+
+    template < typename Record >
+    static void Store(byte* out, const Record& record) {
+        ((Members::Store(out, record), out += Members::Size), ...);
+    }
+
+    template < typename Record >
+    static void Load(const byte* in, Record& record) {
+        ((Members::Load(in, record), in += Members::Size), ...);
+    }
+
+    static bool Valid(const byte* in) {
+        bool valid = true;
+        ((valid = valid && Members::Valid(in), in += Members::Size), ...);
+        return valid;
+    }
+};
+
+template < typename Record >
+constexpr size_t EncodedSize = Codec<Record>::Size;
+
+// Returns pointer past the record, `nullptr` if it doesn't fit
+template < typename Record >
+byte* WriteRecord(byte* bBegin, byte* bEnd, const Record& record) {
+    if (static_cast<size_t>(bEnd - bBegin) < EncodedSize<Record>)
+        return nullptr;
+
+    Codec<Record>::Store(bBegin, record);
+    return bBegin + EncodedSize<Record>;
+}
+
+template < typename Record >
+const byte* ReadRecord(const byte* bBegin, const byte* bEnd, Record& record) {
+    if (static_cast<size_t>(bEnd - bBegin) < EncodedSize<Record>)
+        return nullptr;
+
+    if (!Codec<Record>::Valid(bBegin))
+        return nullptr;
+
+    Codec<Record>::Load(bBegin, record);
+    return bBegin + EncodedSize<Record>;
+}
+
+// Writes `count` records starting from `first` back to back
+template < typename Iterator >
+byte* WriteRecords(byte* bBegin, byte* bEnd, Iterator first, size_t count) {
+    using Record = typename std::iterator_traits<Iterator>::value_type;
+    constexpr size_t size = EncodedSize<Record>;
+
+    if (static_cast<size_t>(bEnd - bBegin) / size < count)
+        return nullptr;
+
+    for (size_t i = 0; i < count; ++i, ++first, bBegin += size)
+        Codec<Record>::Store(bBegin, *first);
+
+    return bBegin;
+}
+
+// Checks `count` records starting from `bBegin`, which must fit
+template < typename Record >
+bool ValidRecords(const byte* bBegin, size_t count) {
+    for (size_t i = 0; i < count; ++i, bBegin += EncodedSize<Record>) {
+        if (!Codec<Record>::Valid(bBegin))
+            return false;
+    }
+
+    return true;
+}
+
+// Calls `handler(record)` for each of `count` records, for none of them
+// if some record is invalid
+template < typename Record, typename Handler >
+const byte* ReadRecords(const byte* bBegin, const byte* bEnd, size_t count, Handler handler) {
+    constexpr size_t size = EncodedSize<Record>;
+
+    if (static_cast<size_t>(bEnd - bBegin) / size < count)
+        return nullptr;
+    if (!ValidRecords<Record>(bBegin, count))
+        return nullptr;
+
+    Record record{};
+    for (size_t i = 0; i < count; ++i, bBegin += size) {
+        Codec<Record>::Load(bBegin, record);
+        handler(record);
+    }
+
+    return bBegin;
+}
+
+#endif // HEADERS_CODEC_HPP_
@@ -0,0 +1,113 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_CONFIG_HPP_
+#define HEADERS_CONFIG_HPP_
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <wire.hpp>
+
+
+// Daemon settings, every field could be overridden with env variable
+struct Config {
+    uint16_t Port = 8005;                               // GOSSIP_PORT
+    std::size_t ReceiveBatchSize = 64;                  // GOSSIP_RECEIVE_BATCH
+    // Receiving sockets sharing the port, each one is read by a thread
+    // pinned to its own core
+    std::size_t ReceiveThreads = 1;                     // GOSSIP_RECEIVE_THREADS
+    std::size_t DatagramSize = 1500;                    // GOSSIP_DATAGRAM_SIZE
+    // Outgoing gossips never exceed it, keep below path MTU and DatagramSize
+    std::size_t GossipMTU = 1400;                       // GOSSIP_MTU
+    std::size_t RetransmitMult = 3;                     // GOSSIP_RETRANSMIT_MULT
+    std::size_t QueueCapacity = 4096;                   // GOSSIP_QUEUE_CAPACITY
+    std::size_t SendArenaSize = 64*1024;                // GOSSIP_SEND_ARENA
+    std::chrono::milliseconds ProtocolPeriod{200};      // GOSSIP_PERIOD_MS
+    // Both versions are always accepted, this one is sent.
+    // Switch to v2 once every node in cluster runs a v2-aware build
+    WireVersion SendVersion = WireVersion::V1;          // GOSSIP_WIRE_VERSION
+    // Local applications subscribe to membership changes here. Clients
+    // that fall this far behind are disconnected
+    std::string AppSocket = "./socket.sock";            // GOSSIP_APP_SOCKET
+    std::size_t AppBacklog = 4*1024*1024;               // GOSSIP_APP_BACKLOG
+    // Memory-mapped view of the table for local readers (shared_view.hpp),
+    // empty disables it. Put it on tmpfs, e.g. /dev/shm
+    std::string SharedView = "./view.shm";              // GOSSIP_SHARED_VIEW
+    uint32_t SharedViewCapacity = 64*1024;              // GOSSIP_SHARED_VIEW_CAPACITY
+    // The table is restored from it on start, empty disables it
+    std::string Snapshot = "./table.snapshot";          // GOSSIP_SNAPSHOT
+    std::chrono::milliseconds SnapshotInterval{5000};   // GOSSIP_SNAPSHOT_INTERVAL_MS
+    // Snapshot of metrics is written to every client, empty disables it
+    std::string MetricsSocket = "./metrics.sock";       // GOSSIP_METRICS_SOCKET
+    // Address other members reach this one by
+    std::string AdvertiseIP = "127.0.0.1";              // GOSSIP_ADVERTISE_IP
+    // Members to join through, "ip:port,ip:port"
+    std::string Seeds = "";                             // GOSSIP_SEEDS
+    // Full state exchange over TCP on `Port`, zero interval leaves
+    // only the one on join
+    std::chrono::milliseconds PushPullInterval{30000};  // GOSSIP_PUSH_PULL_INTERVAL_MS
+    std::chrono::milliseconds PushPullTimeout{5000};    // GOSSIP_PUSH_PULL_TIMEOUT_MS
+    std::size_t PushPullMaxInbound = 4;                 // GOSSIP_PUSH_PULL_MAX_INBOUND
+    std::size_t PushPullMaxBytes = 16*1024*1024;        // GOSSIP_PUSH_PULL_MAX_BYTES
+    // Periodic exchanges send only diverged ranges of the table and
+    // gossips carry no table samples. Use with a short push-pull interval
+    bool AntiEntropy = false;                           // GOSSIP_ANTI_ENTROPY
+    // Failure detector runs only with v2 wire format
+    std::chrono::milliseconds ProbeInterval{1000};      // GOSSIP_PROBE_INTERVAL_MS
+    std::chrono::milliseconds ProbeTimeout{500};        // GOSSIP_PROBE_TIMEOUT_MS
+    std::size_t IndirectChecks = 3;                     // GOSSIP_INDIRECT_CHECKS
+    std::size_t SuspicionMult = 4;                      // GOSSIP_SUSPICION_MULT
+    std::size_t SuspicionMaxMult = 6;                   // GOSSIP_SUSPICION_MAX_MULT
+    std::size_t MaxHealthScore = 8;                     // GOSSIP_MAX_HEALTH_SCORE
+
+    static Config FromEnv();
+};
+
+
+// Leaves `value` untouched if variable isn't set, throws if it's malformed
+// or doesn't fit `Type` or is below `minimum`
+template < typename Type >
+void ReadEnv(const char* name, Type& value, Type minimum = std::numeric_limits<Type>::lowest()) {
+    const char* str = std::getenv(name);
+    if (!str)
+        return;
+
+    char* end = nullptr;
+    errno = 0;
+    bool inRange = false;
+    Type parsed{};
+    if constexpr (std::is_floating_point<Type>::value) {
+        double number = std::strtod(str, &end);
+        inRange = errno != ERANGE && number >= std::numeric_limits<Type>::lowest() &&
+                  number <= std::numeric_limits<Type>::max();
+        if (inRange)
+            parsed = static_cast<Type>(number);
+    } else {
+        // `strtoull` negates values with a minus instead of failing
+        unsigned long long number = std::strtoull(str, &end, 10);
+        inRange = errno != ERANGE && std::strchr(str, '-') == nullptr &&
+                  number <= static_cast<unsigned long long>(std::numeric_limits<Type>::max());
+        parsed = static_cast<Type>(number);
+    }
+
+    if (end == str || *end != '\0' || !inRange || parsed < minimum) {
+        throw std::invalid_argument{
+            std::string{"Invalid value of "} + name + ": " + str
+        };
+    }
+    value = parsed;
+}
+
+void ReadEnv(const char* name, std::string& value);
+void ReadEnv(const char* name, std::chrono::milliseconds& value,
+             std::chrono::milliseconds minimum = std::chrono::milliseconds::min());
+
+#endif // HEADERS_CONFIG_HPP_
@@ -0,0 +1,98 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_CONNECTOR_HPP_
+#define HEADERS_CONNECTOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/streambuf.hpp>
+
+#include <json_writer.hpp>
+#include <types.hpp>
+
+
+/* AppConnector protocol, one JSON object per line
+ *
+ *   client                                         daemon
+ *     |-- {} or {"epoch": E, "since": V} ------------->|
+ *     |<- {"type": "snapshot", "epoch": E,            -|   unless resumed
+ *     |    "version": V, "members": [...]}             |
+ *     |<- {"type": "change", "version": V + 1,        -|
+ *     |    "member": {...}}                            |
+ *     |<- ...                                         -|
+ *
+ * Versions are the table's change log versions, they grow by one per
+ * change. A client that reconnects with the epoch and the last version
+ * it has seen gets only the changes it missed, if the log still has
+ * them, and a fresh snapshot otherwise. Epoch changes on every daemon
+ * start. Clients that don't read and fall `maxBacklog` bytes behind
+ * are disconnected, so they can resume later. The first snapshot
+ * doesn't count against `maxBacklog`.
+ *
+ * Works on the `io_service` thread, which is the one that changes the
+ * table, so the table is never read concurrently
+ * */
+
+class AppConnector {
+private:
+    struct Client {
+        boost::asio::local::stream_protocol::socket Socket;
+        boost::asio::streambuf Request;
+        std::string Outbox;
+        std::string Writing;
+        // Unwritten bytes of the first snapshot, they aren't backlog:
+        // a big table alone mustn't get new clients dropped
+        std::size_t Exempt;
+        bool Subscribed;
+
+        explicit Client(boost::asio::io_service& ioService);
+    };
+    using ClientPtr = std::shared_ptr<Client>;
+
+    boost::asio::io_service& ioService_;
+    const MemberTable& table_;
+    boost::asio::local::stream_protocol::acceptor acceptor_;
+    boost::asio::steady_timer acceptRetry_;
+    std::list<ClientPtr> clients_;
+    std::size_t maxBacklog_;
+
+    uint64_t epoch_;
+    uint64_t version_;
+    // Reused by every `Publish()` call
+    std::vector<Member> changes_;
+    std::string events_;
+    MemberTableJSON tableJSON_;
+
+public:
+    AppConnector(boost::asio::io_service& ioService, const MemberTable& table, const std::string& path,
+                 std::size_t maxBacklog = 4*1024*1024);
+
+    void Start();
+    // Streams all table changes since the previous call to subscribed
+    // clients. Call it after every change of the table
+    void Publish();
+
+    std::size_t Clients() const;
+    uint64_t Epoch() const;
+
+private:
+    void Accept();
+    void Subscribe(const ClientPtr& client);
+
+    void Send(const ClientPtr& client, const std::string& data, bool exempt = false);
+    void Flush(const ClientPtr& client);
+    void Drop(const ClientPtr& client);
+
+    std::string Snapshot();
+    static void AppendChange(std::string& out, const Member& member, uint64_t version);
+};
+
+#endif // HEADERS_CONNECTOR_HPP_
@@ -0,0 +1,139 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_DETECTOR_HPP_
+#define HEADERS_DETECTOR_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <types.hpp>
+#include <packer.hpp>
+
+
+struct DetectorConfig {
+    // One member is probed per interval
+    std::chrono::milliseconds ProbeInterval{1000};
+    // No ack during it: ask `IndirectChecks` members to ping the target
+    std::chrono::milliseconds ProbeTimeout{500};
+    size_t IndirectChecks = 3;
+    // Suspicion timeout starts at `SuspicionMaxMult` times the minimal one
+    // `SuspicionMult * log10(N + 1)` probe intervals and shrinks to it as
+    // `IndirectChecks` confirmations arrive
+    size_t SuspicionMult = 4;
+    size_t SuspicionMaxMult = 6;
+    // Probe interval and timeout are stretched up to `MaxHealthScore + 1`
+    // times while this member seems to be slow itself
+    size_t MaxHealthScore = 8;
+};
+
+
+/* SWIM failure detector
+ *
+ *   self                target               helper[k]
+ *    |------- Ping -------->|                    |
+ *    |<------ Ack ----------|                    |      direct, ProbeTimeout
+ *    |                                           |
+ *    |------------------ PingReq --------------->|
+ *    |                      |<------ Ping -------|
+ *    |                      |------- Ack ------->|
+ *    |<------------------ Ack -------------------|      indirect, ProbeInterval
+ *
+ * No ack by the end of the interval marks the target Suspicious. It is
+ * declared Dead when suspicion times out with the same incarnation.
+ * A member refutes suspicion about itself by incrementing incarnation.
+ * All state changes are spread by piggybacking on the `Events` of
+ * every message through the packer.
+ *
+ * Lifeguard extensions keep a slow member from blaming healthy ones:
+ * local health score grows on missed acks and on refutations of
+ * suspicions about itself and drops on every ack, probe timings are
+ * scaled by `score + 1`. Suspicion timeout decreases logarithmically
+ * with the number of distinct members that have suspected the same
+ * incarnation on their own, so real failures are still confirmed
+ * quickly. Every suspicion event names its suspector (wire.hpp),
+ * forwarding doesn't make a member a suspector
+ * */
+
+class FailureDetector {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct Probe {
+        Member Target;
+        uint32_t Sequence = 0;
+        Clock::time_point Start;
+        bool Indirect = false;
+        bool Acked = false;
+        bool Active = false;
+    };
+
+    // Ping sent on behalf of other member's PingReq
+    struct Relay {
+        Member Requester;
+        uint32_t Sequence;
+        Clock::time_point Deadline;
+    };
+
+    struct Suspicion {
+        uint32_t Incarnation;
+        Clock::time_point Start;
+        // Packed addresses of members that suspected on their own,
+        // the first one started the suspicion
+        std::vector<uint64_t> Suspectors;
+    };
+
+    Member self_;
+    DetectorConfig config_;
+    GossipPacker& packer_;
+
+    uint32_t nextSequence_;
+    Probe probe_;
+    Clock::time_point nextProbe_;
+    size_t healthScore_;
+    std::unordered_map<uint32_t, Relay> relays_;
+    std::unordered_map<MemberAddr, Suspicion, MemberAddr::Hasher> suspicions_;
+
+    uint64_t tableVersion_;
+    std::vector<Member> changes_;
+    std::vector<Member> helpers_;
+
+public:
+    FailureDetector(const MemberAddr& self, const DetectorConfig& config, GossipPacker& packer);
+
+    // Answers pings, relays ping-reqs and takes acks. Suspicions
+    // piggybacked on any message confirm by their suspectors
+    void Handle(const GossipView& message, MemberTable& table, Clock::time_point now, std::deque<Gossip>& out);
+    // Runs timers. Call it every protocol round after merging received messages
+    void Tick(MemberTable& table, Clock::time_point now, std::deque<Gossip>& out);
+
+    // Continues after a restart with the incarnation of the previous run,
+    // so its stale records lose to the ones of this run
+    void Restore(uint32_t incarnation);
+
+    const Member& Self() const;
+    size_t Suspicions() const;
+    size_t HealthScore() const;
+
+private:
+    Gossip Message(MessageKind type, uint32_t sequence, const Member& dest, const MemberTable& table,
+                   const Member* target = nullptr);
+
+    void Refute(MemberTable& table);
+    void RunProbe(MemberTable& table, Clock::time_point now, std::deque<Gossip>& out);
+    void Suspect(const Member& target, MemberTable& table, Clock::time_point now);
+    // Returns true if the suspector is new, then its suspicion is spread further
+    bool Confirm(const Member& suspect, const MemberTable& table, Clock::time_point now);
+    void Observe(const MemberTable& table, Clock::time_point now);
+    void ExpireSuspicions(MemberTable& table, Clock::time_point now);
+
+    void RaiseHealthScore();
+    void LowerHealthScore();
+    Clock::duration Scaled(std::chrono::milliseconds timeout) const;
+    Clock::duration SuspicionTimeout(size_t clusterSize, size_t confirmations) const;
+};
+
+#endif // HEADERS_DETECTOR_HPP_
@@ -0,0 +1,66 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_JSON_WRITER_HPP_
+#define HEADERS_JSON_WRITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <types.hpp>
+
+
+// "alive", "suspicious", "dead" or "left"
+const char* StatusName(MemberInfo::State status);
+
+// Appends the same text as `member.ToJSON().dump()` without building
+// a DOM: {"addr":{"IP":"...","port":N},"info":{"incarnation":N,"status":"..."}}
+void AppendJSON(std::string& out, const Member& member);
+
+
+/* MemberTableJSON
+ * |
+ * |__Fragments (Fragment[table size]) -> 88 + 1 + 144 = 240 B each (aligned)
+ * |  |
+ * |  |__Cached (Member)           -> 88 B, record the text was made of
+ * |  |__Size   (uint8_t)          -> 1 B
+ * |  |__Text   (char[MaxSize])    -> 144 B, serialized member
+ * |
+ * |__Out (std::string)            -> "[" fragment "," fragment ... "]"
+ *
+ * Table records never move, so fragments are kept by position and
+ * rebuilt only when the record at it differs from the cached one.
+ * Exporting a table where few members changed is a copy per member.
+ * Texts longer than `MaxSize` aren't cached
+ * */
+
+class MemberTableJSON {
+public:
+    // Longest fragment is an IPv6 member, about 120 characters
+    static constexpr std::size_t MaxSize = 144;
+
+private:
+    struct Fragment {
+        Member Cached;
+        uint8_t Size = 0;
+        char Text[MaxSize];
+    };
+
+    std::vector<Fragment> fragments_;
+    std::string out_;
+    std::string scratch_;
+
+public:
+    // Same text as `table.ToJSON().dump()`, valid until the next call
+    const std::string& Dump(const MemberTable& table);
+    // Appends the array to `out` instead
+    void Append(std::string& out, const MemberTable& table);
+
+private:
+    // Appends the cached text of the member at `i`, rebuilding it if the
+    // record changed
+    void AppendMember(std::string& out, const MemberTable& table, std::size_t i);
+};
+
+#endif // HEADERS_JSON_WRITER_HPP_
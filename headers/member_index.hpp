@@ -0,0 +1,68 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_MEMBER_INDEX_HPP_
+#define HEADERS_MEMBER_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/* MemberIndex (open addressing, groups of 16 slots)
+ * |
+ * |__Control (int8_t[capacity]) -> one byte per slot
+ * |  |______________________________________________
+ * |  | Group[0]: c0 .. c15 | Group[1]: c0 .. c15 | ...
+ * |  |______________________________________________
+ * |     c = Empty (-128) | Deleted (-2) | 7 low bits of key's hash
+ * |
+ * |__Slots (Slot[capacity]) -> Key (48-bit IP:port), Value (position in table)
+ *
+ * Lookup compares 16 control bytes at once (SSE2 when available) and
+ * touches a slot only when its 7-bit hash tag matches. Groups are
+ * probed quadratically, probing stops at the first group with an
+ * empty slot. Load factor is kept below 7/8
+ * */
+
+class MemberIndex {
+public:
+    static constexpr size_t GroupSize = 16;
+
+private:
+    struct Slot {
+        uint64_t Key;
+        size_t Value;
+    };
+
+    std::vector<int8_t> control_;
+    std::vector<Slot> slots_;
+    size_t groupMask_;
+    size_t size_;
+    size_t growthLeft_;
+
+public:
+    MemberIndex();
+
+    // `nullptr` if key is absent
+    const size_t* Find(uint64_t key) const;
+    size_t* Find(uint64_t key);
+    // Returns false if key already exists, its value is kept
+    bool Insert(uint64_t key, size_t value);
+    bool Erase(uint64_t key);
+
+    void Reserve(size_t size);
+    // Keeps the storage, so refilling up to the same size doesn't allocate
+    void Clear();
+
+    size_t Size() const;
+    size_t Capacity() const;
+
+    // Strong 64-bit finalizer, every input bit affects every output bit
+    static uint64_t Mix(uint64_t key);
+
+private:
+    size_t FindSlot(uint64_t key, uint64_t hash) const;
+    void Rehash(size_t groups);
+};
+
+#endif // HEADERS_MEMBER_INDEX_HPP_
@@ -0,0 +1,146 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_METRICS_HPP_
+#define HEADERS_METRICS_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+
+/* MetricsRegistry
+ * |
+ * |__Counters   (name, Slot[MaxThreads])
+ * |__Histograms (name, Slot[MaxThreads] of Buckets[BucketsCount] + Sum)
+ * |__Gauges     (name, callback sampled at snapshot)
+ *
+ * Every thread writes to its own cache line of a metric, so hot paths
+ * never share lines. `Snapshot()` sums slots with relaxed loads, the
+ * result is a consistent enough view for monitoring.
+ * Metrics are registered before threads start and live as long as
+ * the registry
+ * */
+
+class MetricsRegistry {
+public:
+    static constexpr std::size_t MaxThreads = 32;
+    static constexpr std::size_t CacheLine = 64;
+
+    class Counter {
+    private:
+        struct alignas(CacheLine) Slot {
+            std::atomic<uint64_t> Value{0};
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+
+    public:
+        Counter();
+
+        void Add(uint64_t value = 1);
+        uint64_t Value() const;
+    };
+
+    // Latencies in microseconds, bucket `i` counts values up to 2^i inclusive
+    class Histogram {
+    public:
+        static constexpr std::size_t BucketsCount = 22;
+
+    private:
+        struct alignas(CacheLine) Slot {
+            std::array<std::atomic<uint64_t>, BucketsCount> Buckets{};
+            std::atomic<uint64_t> Sum{0};
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+
+    public:
+        Histogram();
+
+        void Record(std::chrono::nanoseconds latency);
+        uint64_t Bucket(std::size_t i) const;
+        uint64_t Count() const;
+        // Microseconds
+        uint64_t Sum() const;
+    };
+
+    using Gauge = std::function<int64_t()>;
+
+private:
+    template < typename Metric >
+    struct Named {
+        std::string Name;
+        Metric Value;
+    };
+
+    std::deque<Named<Counter>> counters_;
+    std::deque<Named<Histogram>> histograms_;
+    std::deque<Named<Gauge>> gauges_;
+
+public:
+    Counter& AddCounter(const std::string& name);
+    Histogram& AddHistogram(const std::string& name);
+    void AddGauge(const std::string& name, Gauge gauge);
+
+    // One `name value` per line, histograms as cumulative
+    // `name_bucket{le="..."}`, `name_sum` and `name_count` lines
+    std::string Snapshot() const;
+
+    // Slot of the calling thread, assigned on its first call
+    static std::size_t ThreadSlot();
+};
+
+
+// Records time from construction to destruction
+class ScopedTimer {
+private:
+    MetricsRegistry::Histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    explicit ScopedTimer(MetricsRegistry::Histogram& histogram);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+
+// Writes a snapshot to every client connected to the UNIX socket at
+// `path` and closes the connection. Served by `ioService` thread,
+// which never waits for a client to read
+class MetricsServer {
+private:
+    struct Client {
+        boost::asio::local::stream_protocol::socket Socket;
+        std::string Snapshot;
+
+        explicit Client(boost::asio::io_service& ioService);
+    };
+    using ClientPtr = std::shared_ptr<Client>;
+
+    boost::asio::io_service& ioService_;
+    const MetricsRegistry& registry_;
+    boost::asio::local::stream_protocol::acceptor acceptor_;
+    boost::asio::steady_timer acceptRetry_;
+
+public:
+    MetricsServer(boost::asio::io_service& ioService, const MetricsRegistry& registry, const std::string& path);
+
+    void Start();
+
+private:
+    void Accept();
+};
+
+#endif // HEADERS_METRICS_HPP_
@@ -0,0 +1,146 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_NETWORK_HPP_
+#define HEADERS_NETWORK_HPP_
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include <buffer.hpp>
+
+
+/* DatagramBatch
+ * |
+ * |__Buffer (ByteBuffer) -> SlotSize * SlotsCount B
+ * |  |___________________________________________
+ * |  | Slot[0] | Slot[1] |  .......  | Slot[n-1] |
+ * |  |___________________________________________
+ * |
+ * |__Headers (mmsghdr[n])     -> one per slot, points to Slot[i] and Sender[i]
+ * |__Senders (sockaddr_storage[n])
+ *
+ * Slots are preallocated once and reused by every `Receive()` call
+ * */
+
+class DatagramBatch {
+private:
+    ByteBuffer buffer_;
+    std::size_t slotSize_;
+    std::vector<mmsghdr> headers_;
+    std::vector<iovec> iovecs_;
+    std::vector<sockaddr_storage> senders_;
+    std::size_t received_;
+
+    // Amortization statistics
+    std::size_t totalCalls_;
+    std::size_t totalDatagrams_;
+
+public:
+    DatagramBatch(std::size_t slotsCount, std::size_t slotSize);
+
+    DatagramBatch(const DatagramBatch&) = delete;
+    DatagramBatch& operator=(const DatagramBatch&) = delete;
+
+    // Blocks until at least one datagram arrives, then takes all the pending
+    // ones that fit into the slots with a single `recvmmsg` syscall.
+    // Returns the number of received datagrams (0 if interrupted by signal)
+    std::size_t Receive(int sockfd);
+
+    std::size_t Capacity() const;
+    std::size_t Size() const;
+
+    const byte* Begin(std::size_t i) const;
+    const byte* End(std::size_t i) const;
+    // Datagram was longer than slot and its tail is lost
+    bool Truncated(std::size_t i) const;
+    boost::asio::ip::udp::endpoint Sender(std::size_t i) const;
+
+    std::size_t TotalCalls() const;
+    std::size_t TotalDatagrams() const;
+};
+
+
+/* DatagramSender
+ * |
+ * |__Arena (ByteBuffer) -> datagrams serialized back to back
+ * |  |__________________________________________
+ * |  | Datagram[0] | Datagram[1] | ... |  free   |
+ * |  |__________________________________________
+ * |
+ * |__Pending (Datagram: Offset, Size, Dest)[n]
+ *
+ * `Flush()` sends all pending datagrams with `sendmmsg`. Consecutive
+ * datagrams to the same destination with equal sizes are glued into one
+ * UDP GSO super-datagram, so the kernel segments them instead of us
+ * */
+
+class DatagramSender {
+private:
+    struct Datagram {
+        std::size_t Offset;
+        std::size_t Size;
+        boost::asio::ip::udp::endpoint Dest;
+    };
+
+    ByteBuffer arena_;
+    std::size_t used_;
+    std::vector<Datagram> pending_;
+    bool gso_;
+
+    // Reused by every `Flush()` call
+    std::vector<mmsghdr> headers_;
+    std::vector<iovec> iovecs_;
+    std::vector<sockaddr_storage> dests_;
+    std::vector<uint64_t> controls_;
+    // Index of the first pending datagram carried by each message
+    std::vector<std::size_t> firsts_;
+
+    std::size_t totalCalls_;
+    std::size_t totalDatagrams_;
+
+public:
+    explicit DatagramSender(std::size_t arenaSize, bool gso = true);
+
+    DatagramSender(const DatagramSender&) = delete;
+    DatagramSender& operator=(const DatagramSender&) = delete;
+
+    // Free arena space for the next datagram
+    byte* Begin();
+    byte* End();
+    // Marks `size` bytes from `Begin()` as a datagram for `dest`
+    void Commit(std::size_t size, const boost::asio::ip::udp::endpoint& dest);
+
+    std::size_t PendingCount() const;
+    // Sends everything committed and frees the arena
+    void Flush(int sockfd);
+
+    bool GSOEnabled() const;
+    std::size_t TotalCalls() const;
+    std::size_t TotalDatagrams() const;
+
+private:
+    // Fills message headers for pending datagrams starting from `first`
+    std::size_t Prepare(std::size_t first);
+};
+
+
+// Sockets sharing a port with `SO_REUSEPORT` split incoming datagrams
+// between themselves by the hash of the sender's address
+using ReusePort = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+// Opens UDP socket on `port` of all interfaces. Every one of the sockets
+// bound with `reusePort` to the same port receives its own share of datagrams
+boost::asio::ip::udp::socket BindUDP(boost::asio::io_service& ioService, uint16_t port, bool reusePort = false);
+
+// Binds thread to one CPU (modulo the number of CPUs). Returns false if
+// the system refused, then thread keeps running anywhere
+bool PinToCore(std::thread& thread, std::size_t core);
+
+#endif // HEADERS_NETWORK_HPP_
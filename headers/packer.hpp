@@ -0,0 +1,73 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_PACKER_HPP_
+#define HEADERS_PACKER_HPP_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <types.hpp>
+#include <wire.hpp>
+
+
+// Builds outgoing gossips that fill a datagram up to MTU but never more.
+// State changes waiting for dissemination are piggybacked first: the
+// least transmitted ones, Dead/Suspicious/Left before Alive, fresher
+// incarnations before older. Every change is retransmitted about
+// `RetransmitMult * log(ClusterSize)` times, the rest of the datagram
+// is filled with random table samples unless anti-entropy exchanges
+// (sync.hpp) repair tables instead
+class GossipPacker {
+private:
+    struct Broadcast {
+        Member Event;
+        size_t Transmits;
+    };
+
+    std::vector<Broadcast> broadcasts_;
+    std::unordered_map<MemberAddr, size_t, MemberAddr::Hasher> index_;
+
+    size_t mtu_;
+    WireVersion version_;
+    size_t retransmitMult_;
+    bool samples_;
+
+    // Reused by every `Pack()` call
+    std::vector<size_t> order_;
+    std::vector<Member> sampled_;
+
+    uint64_t tableVersion_;
+    std::vector<Member> changes_;
+
+public:
+    GossipPacker(size_t mtu, WireVersion version, size_t retransmitMult = 3, bool samples = true);
+
+    // Replaces a queued change about the same member if this one overrides
+    // it or confirms its suspicion on behalf of another suspector
+    void Enqueue(const Member& event);
+    template < typename EventsRange >
+    void Enqueue(const EventsRange& events) {
+        for (const auto& event : events)
+            Enqueue(event);
+    }
+    // Enqueues everything the table has changed since the previous call
+    void Sync(const MemberTable& table);
+
+    Gossip Pack(uint16_t ttl, const Member& owner, const Member& dest, const MemberTable& table);
+    // Builds into a reset gossip (`GossipBatch::Next()`), reusing its storage
+    void Pack(Gossip& gossip, uint16_t ttl, const Member& owner, const Member& dest, const MemberTable& table);
+    // Piggybacks changes and samples on a gossip with header fields set
+    void Fill(Gossip& gossip, const MemberTable& table);
+
+    size_t Pending() const;
+    size_t MTU() const;
+    WireVersion Version() const;
+
+private:
+    size_t RetransmitLimit(size_t clusterSize) const;
+    static size_t RecordSize(const Member& member, uint32_t& prevIncarnation, WireVersion version);
+    void Retire(size_t limit);
+};
+
+#endif // HEADERS_PACKER_HPP_
@@ -0,0 +1,137 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_QUEUE_HPP_
+#define HEADERS_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+
+/* MPSCQueue (capacity = 2^k)
+ * |
+ * |__Cells (Cell[capacity])
+ * |  |____________________________________________
+ * |  | Seq | Value | Seq | Value |  ....  | Seq | Value |
+ * |  |____________________________________________
+ * |
+ * |__EnqueuePos (atomic, shared by producers)
+ * |__DequeuePos (owned by the single consumer)
+ *
+ * Bounded ring with per-cell sequence numbers (D. Vyukov's scheme).
+ * Producers claim a cell with one CAS and publish it by bumping its
+ * sequence, the consumer takes published cells without any locking.
+ * When the ring is full `Push()` drops the value and counts it
+ * */
+
+template < typename Type >
+class MPSCQueue {
+private:
+    static constexpr std::size_t CacheLine = 64;
+
+    struct Cell {
+        std::atomic<std::size_t> Sequence;
+        Type Value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_;
+
+    alignas(CacheLine) std::atomic<std::size_t> enqueuePos_;
+    alignas(CacheLine) std::atomic<std::size_t> dequeuePos_;
+    alignas(CacheLine) std::atomic<std::size_t> drops_;
+
+public:
+    // Capacity is rounded up to the power of two
+    explicit MPSCQueue(std::size_t capacity)
+      : cells_{}
+      , mask_{0}
+      , enqueuePos_{0}
+      , dequeuePos_{0}
+      , drops_{0}
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        cells_.reset(new Cell[size]);
+        mask_ = size - 1;
+        for (std::size_t i = 0; i < size; ++i)
+            cells_[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Safe to call from any number of threads
+    bool Push(Type&& value) {
+        std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        while (true) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // Consumer hasn't freed this cell yet: ring is full
+                drops_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->Value = std::move(value);
+        cell->Sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Only the single consumer thread may call it.
+    // Moves published values to the end of `bucket` (any container with
+    // `push_back`), returns their number. Takes at most `Capacity()` of
+    // them, so producers publishing all along can't keep it looping
+    template < typename Bucket >
+    std::size_t Drain(Bucket& bucket) {
+        std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        std::size_t count = 0;
+
+        while (count < Capacity()) {
+            Cell& cell = cells_[pos & mask_];
+            std::size_t seq = cell.Sequence.load(std::memory_order_acquire);
+            if (seq != pos + 1)
+                break;
+
+            bucket.push_back(std::move(cell.Value));
+            cell.Sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+            ++pos;
+            ++count;
+        }
+
+        dequeuePos_.store(pos, std::memory_order_relaxed);
+        return count;
+    }
+
+    std::size_t Capacity() const {
+        return mask_ + 1;
+    }
+
+    // Approximate number of values waiting for the consumer
+    std::size_t Depth() const {
+        std::size_t enqueued = enqueuePos_.load(std::memory_order_relaxed);
+        std::size_t dequeued = dequeuePos_.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    std::size_t Drops() const {
+        return drops_.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // HEADERS_QUEUE_HPP_
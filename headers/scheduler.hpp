@@ -0,0 +1,48 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_SCHEDULER_HPP_
+#define HEADERS_SCHEDULER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+
+// Runs protocol round on `io_service` thread once per period.
+// `Notify()` wakes it earlier, so fresh gossips are merged and forwarded
+// without waiting for the whole period, while an idle daemon just sleeps
+class ProtocolScheduler {
+private:
+    boost::asio::io_service& ioService_;
+    boost::asio::steady_timer timer_;
+    std::chrono::milliseconds period_;
+    std::function<void()> round_;
+
+    // Set while a wake-up is posted but the round hasn't started yet
+    std::atomic<bool> notified_;
+    std::size_t rounds_;
+
+public:
+    ProtocolScheduler(boost::asio::io_service& ioService,
+                      std::chrono::milliseconds period,
+                      std::function<void()> round);
+
+    ProtocolScheduler(const ProtocolScheduler&) = delete;
+    ProtocolScheduler& operator=(const ProtocolScheduler&) = delete;
+
+    // Arms the timer, rounds are run by `io_service::run()`
+    void Start();
+    // Safe to call from any thread, repeated calls before round are coalesced
+    void Notify();
+
+    std::size_t Rounds() const;
+
+private:
+    void Arm();
+    void Run();
+};
+
+#endif // HEADERS_SCHEDULER_HPP_
@@ -0,0 +1,207 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_SHARED_VIEW_HPP_
+#define HEADERS_SHARED_VIEW_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* Membership view shared by the daemon through a memory-mapped file
+ *
+ * SharedViewHeader  ----------------> 64 + 64 = 128 B
+ * |
+ * |__Magic         (uint32_t)      -> 4 B
+ * |__LayoutVersion (uint16_t)      -> 2 B
+ * |__RecordSize    (uint16_t)      -> 2 B
+ * |__Capacity      (uint32_t)      -> 4 B     padded to 64 B
+ * |
+ * |__Sequence (atomic<uint64_t>)   -> 8 B     odd while being written
+ * |__Version  (atomic<uint64_t>)   -> 8 B     table's change log version
+ * |__Count    (atomic<uint32_t>)   -> 4 B
+ * |__Total    (atomic<uint32_t>)   -> 4 B     members in the table
+ *
+ * SharedMemberRecord[Capacity] ------> 32 B * Capacity
+ * |
+ * |__Address  (uint8_t[16])        -> 16 B    IPv4 in first 4 bytes
+ * |__Port     (uint16_t)           -> 2 B
+ * |__Family   (uint8_t)            -> 1 B     4 or 6
+ * |__Status   (uint8_t)            -> 1 B     `MemberInfo::State`
+ * |__Incarnation (uint32_t)        -> 4 B
+ * |__LastUpdate  (uint32_t)        -> 4 B
+ * |__Reserved    (uint32_t)        -> 4 B
+ *
+ * All numbers are in host byte order. The daemon is the only writer,
+ * it guards every rewrite with a seqlock: `Sequence` is odd while
+ * records change. Readers copy records and retry if `Sequence` moved,
+ * so reading never blocks the daemon and takes no syscalls unless it
+ * meets an update in progress.
+ *
+ * This header is everything a local process needs to read the view,
+ * it depends on nothing but libc
+ * */
+
+struct SharedMemberRecord {
+    enum State : uint8_t {
+        Alive = 0,
+        Suspicious = 1,
+        Dead = 2,
+        Left = 3
+    };
+
+    uint8_t Address[16];
+    uint16_t Port;
+    uint8_t Family;
+    uint8_t Status;
+    uint32_t Incarnation;
+    uint32_t LastUpdate;
+    uint32_t Reserved;
+};
+static_assert(sizeof(SharedMemberRecord) == 32, "Shared record layout changed");
+
+struct SharedViewHeader {
+    static constexpr uint32_t MagicValue = 0x47535056;  // "GSPV"
+    static constexpr uint16_t Layout = 1;
+
+    uint32_t Magic;
+    uint16_t LayoutVersion;
+    uint16_t RecordSize;
+    uint32_t Capacity;
+
+    alignas(64) std::atomic<uint64_t> Sequence;
+    std::atomic<uint64_t> Version;
+    std::atomic<uint32_t> Count;
+    std::atomic<uint32_t> Total;
+};
+static_assert(sizeof(SharedViewHeader) == 128, "Shared header layout changed");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Seqlock needs address-free atomics");
+
+inline std::size_t SharedViewSize(uint32_t capacity) {
+    return sizeof(SharedViewHeader) + sizeof(SharedMemberRecord) * capacity;
+}
+
+
+// Maps the view read-only. Throws `std::runtime_error` if the file is
+// missing or isn't a view of this layout
+class SharedViewReader {
+private:
+    // A writer that died mid-update leaves `Sequence` odd forever
+    static const std::size_t MaxAttempts = 1024;
+
+    void* map_;
+    std::size_t size_;
+    // Records that fit the mapping, `Capacity` in the file can't be trusted
+    // after the open: it's shared memory
+    std::size_t capacity_;
+
+public:
+    explicit SharedViewReader(const std::string& path)
+      : map_{MAP_FAILED}
+      , size_{0}
+      , capacity_{0}
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error{"Unable to open shared view " + path};
+
+        struct stat info{};
+        if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) >= sizeof(SharedViewHeader)) {
+            size_ = static_cast<std::size_t>(info.st_size);
+            map_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+
+        if (map_ == MAP_FAILED)
+            throw std::runtime_error{"Unable to map shared view " + path};
+
+        const SharedViewHeader* header = Header();
+        if (header->Magic != SharedViewHeader::MagicValue ||
+            header->LayoutVersion != SharedViewHeader::Layout ||
+            header->RecordSize != sizeof(SharedMemberRecord) ||
+            SharedViewSize(header->Capacity) > size_) {
+            ::munmap(map_, size_);
+            throw std::runtime_error{"Unknown layout of shared view " + path};
+        }
+        capacity_ = (size_ - sizeof(SharedViewHeader)) / sizeof(SharedMemberRecord);
+    }
+
+    ~SharedViewReader() {
+        ::munmap(map_, size_);
+    }
+
+    SharedViewReader(const SharedViewReader&) = delete;
+    SharedViewReader& operator=(const SharedViewReader&) = delete;
+
+    // Cheap check whether anything changed since the last `Read()`
+    uint64_t Version() const {
+        return Header()->Version.load(std::memory_order_acquire);
+    }
+
+    // Replaces `members` with a consistent copy of the view and sets
+    // `version` to its version. Returns false if the daemon didn't
+    // finish an update in time (most likely it's dead) or replaced the
+    // file on a restart, then the view has to be reopened
+    bool Read(std::vector<SharedMemberRecord>& members, uint64_t& version, bool aliveOnly = true) const {
+        const SharedViewHeader* header = Header();
+        const SharedMemberRecord* records = Records();
+
+        for (std::size_t attempt = 0; attempt < MaxAttempts; ++attempt) {
+            uint64_t begin = header->Sequence.load(std::memory_order_acquire);
+            if (begin & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            uint32_t count = header->Count.load(std::memory_order_relaxed);
+            version = header->Version.load(std::memory_order_relaxed);
+            if (count > capacity_)
+                continue;
+
+            members.resize(count);
+            std::memcpy(members.data(), records, sizeof(SharedMemberRecord) * count);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->Sequence.load(std::memory_order_relaxed) != begin)
+                continue;
+
+            if (aliveOnly) {
+                std::size_t alive = 0;
+                for (const auto& member : members) {
+                    if (member.Status == SharedMemberRecord::Alive)
+                        members[alive++] = member;
+                }
+                members.resize(alive);
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    // Members in the table, more than `Read()` gives if the view is full
+    uint32_t Total() const {
+        return Header()->Total.load(std::memory_order_relaxed);
+    }
+
+private:
+    const SharedViewHeader* Header() const {
+        return static_cast<const SharedViewHeader*>(map_);
+    }
+
+    const SharedMemberRecord* Records() const {
+        return reinterpret_cast<const SharedMemberRecord*>(static_cast<const char*>(map_) + sizeof(SharedViewHeader));
+    }
+};
+
+#endif // HEADERS_SHARED_VIEW_HPP_
@@ -0,0 +1,45 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_SHARED_WRITER_HPP_
+#define HEADERS_SHARED_WRITER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <shared_view.hpp>
+#include <types.hpp>
+
+
+// Daemon side of the shared view (see shared_view.hpp). Creates the
+// file at `path` sized for `capacity` records, members above it are
+// left out. A previous file of another size is replaced, not resized,
+// and its readers fail `Read()` until they reopen the path.
+// Throws `std::runtime_error` if the file can't be mapped
+class SharedViewWriter {
+private:
+    void* map_;
+    std::size_t size_;
+    uint64_t published_;
+
+public:
+    SharedViewWriter(const std::string& path, uint32_t capacity);
+    ~SharedViewWriter();
+
+    SharedViewWriter(const SharedViewWriter&) = delete;
+    SharedViewWriter& operator=(const SharedViewWriter&) = delete;
+
+    // Rewrites the view if the table changed since the previous call.
+    // Returns true if it did
+    bool Publish(const MemberTable& table);
+
+private:
+    SharedViewHeader* Header();
+    SharedMemberRecord* Records();
+};
+
+// Conversions between table records and fixed shared ones
+void ToSharedRecord(const Member& member, SharedMemberRecord& record);
+Member FromSharedRecord(const SharedMemberRecord& record);
+
+#endif // HEADERS_SHARED_WRITER_HPP_
@@ -0,0 +1,162 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_SIMULATOR_HPP_
+#define HEADERS_SIMULATOR_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <behavior.hpp>
+#include <detector.hpp>
+#include <packer.hpp>
+#include <types.hpp>
+
+
+// Simulation settings, every field could be overridden with env variable
+struct SimulationConfig {
+    std::size_t Nodes = 1000;                           // GOSSIP_SIM_NODES
+    std::chrono::milliseconds Duration{30000};          // GOSSIP_SIM_DURATION_MS
+    std::chrono::milliseconds ProtocolPeriod{200};      // GOSSIP_SIM_PERIOD_MS
+    // One way delay is `Latency + U[0, Jitter]`
+    std::chrono::milliseconds Latency{5};               // GOSSIP_SIM_LATENCY_MS
+    std::chrono::milliseconds Jitter{5};                // GOSSIP_SIM_JITTER_MS
+    double Loss = 0.0;                                  // GOSSIP_SIM_LOSS
+    uint32_t Seed = 1;                                  // GOSSIP_SIM_SEED
+
+    // Every node starts `Fanout` gossips with `TTL` each period
+    std::size_t Fanout = 1;                             // GOSSIP_SIM_FANOUT
+    uint16_t TTL = 3;                                   // GOSSIP_SIM_TTL
+    std::size_t GossipMTU = 1400;                       // GOSSIP_SIM_MTU
+    std::size_t RetransmitMult = 3;                     // GOSSIP_SIM_RETRANSMIT_MULT
+    WireVersion Version = WireVersion::V2;              // GOSSIP_SIM_WIRE_VERSION
+    // Needs v2 wire format
+    bool Detection = true;                              // GOSSIP_SIM_DETECTION
+    DetectorConfig Detector;                            // GOSSIP_SIM_PROBE_INTERVAL_MS, ...
+
+    // `Crashes` nodes from the end stop at `CrashAt`
+    std::size_t Crashes = 0;                            // GOSSIP_SIM_CRASHES
+    std::chrono::milliseconds CrashAt{10000};           // GOSSIP_SIM_CRASH_AT_MS
+    // First `PartitionSize` nodes can't talk to the rest in [From, To)
+    std::size_t PartitionSize = 0;                      // GOSSIP_SIM_PARTITION_SIZE
+    std::chrono::milliseconds PartitionFrom{0};         // GOSSIP_SIM_PARTITION_FROM_MS
+    std::chrono::milliseconds PartitionTo{0};           // GOSSIP_SIM_PARTITION_TO_MS
+
+    static SimulationConfig FromEnv();
+};
+
+
+struct SimulationReport {
+    // Negative if never happened
+    double JoinConvergenceMs = -1;      // every live node knows every node
+    double FailureConvergenceMs = -1;   // every live node marked crashed ones dead, since the crash
+    double BytesPerNodePerSecond = 0;
+    std::size_t Datagrams = 0;
+    std::size_t Lost = 0;               // random loss, partitions and crashed receivers
+    std::size_t Coalesced = 0;          // duplicate records dropped by merges
+    // Times a live member was marked suspicious or dead by somebody
+    std::size_t FalseSuspicions = 0;
+    std::size_t FalseDeaths = 0;
+    // False deaths per pair of live observer and live member
+    double FalsePositiveRate = 0;
+
+    nlohmann::json ToJSON() const;
+};
+
+
+/* Simulator
+ * |
+ * |__Nodes[n] (MemberTable, GossipPacker, FailureDetector, inbox)
+ * |__Events (priority queue by virtual time)
+ *    |__Round    -> node drains inbox, merges, probes and gossips
+ *    |__Deliver  -> datagram reaches node's inbox
+ *    |__Check    -> convergence and false positives are measured
+ *
+ * Thousands of nodes run in one thread over a virtual network and a
+ * virtual clock. Nodes use the same merge, packing and codec as the
+ * daemon, every datagram is serialized and parsed for real. All the
+ * randomness comes from `Seed`, so runs are reproducible
+ * */
+
+class Simulator {
+public:
+    using Clock = FailureDetector::Clock;
+    using Time = Clock::time_point;
+
+private:
+    struct Node {
+        Member Self;
+        MemberTable Table;
+        GossipPacker Packer;
+        FailureDetector Detector;
+        std::vector<Packet> Inbox;
+
+        // Cursor over table changes for false positives counting
+        uint64_t TableVersion;
+        std::vector<Member> Changes;
+
+        Node(const SimulationConfig& config, const Member& self, uint32_t seed);
+    };
+
+    enum class EventKind {
+        Round,
+        Deliver,
+        Check
+    };
+
+    struct Event {
+        Time At;
+        uint64_t Order;     // keeps events of the same time in FIFO order
+        EventKind Kind;
+        std::size_t Node;
+        std::size_t Payload;
+
+        bool operator>(const Event& rhs) const;
+    };
+
+    SimulationConfig config_;
+    std::mt19937 generator_;
+    std::vector<std::unique_ptr<Node>> nodes_;
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t order_;
+    // Reused by every round
+    MergeBatch merge_;
+    GossipBatch gossips_;
+    std::vector<Member> targets_;
+    // Datagrams in flight, freed slots are reused
+    std::vector<ByteBuffer> payloads_;
+    std::vector<std::size_t> freePayloads_;
+
+    SimulationReport report_;
+    std::size_t bytes_;
+
+public:
+    explicit Simulator(const SimulationConfig& config);
+
+    SimulationReport Run();
+
+    // Virtual address of node `i`
+    static MemberAddr Address(std::size_t i);
+
+private:
+    void Schedule(Time at, EventKind kind, std::size_t node, std::size_t payload = 0);
+
+    void Round(std::size_t node, Time now);
+    template < typename Gossips >
+    void Send(std::size_t from, const Gossips& gossips, Time now);
+    void Deliver(std::size_t node, std::size_t payload, Time now);
+    void Check(Time now);
+
+    bool Reachable(std::size_t from, std::size_t to, Time now) const;
+    bool CrashedAt(std::size_t node, Time now) const;
+    Time Since(std::chrono::milliseconds offset) const;
+};
+
+#endif // HEADERS_SIMULATOR_HPP_
@@ -0,0 +1,114 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_SNAPSHOT_HPP_
+#define HEADERS_SNAPSHOT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <shared_view.hpp>
+#include <types.hpp>
+
+
+/* Snapshot file  -----------------> 64 + 2 * 64 + 2 * 32 * Capacity B
+ * |
+ * |__Header        -> 64 B
+ * |  |__Magic         (uint32_t) -> "GSNP"
+ * |  |__LayoutVersion (uint16_t)
+ * |  |__RecordSize    (uint16_t)
+ * |  |__Capacity      (uint32_t) -> records per slot
+ * |
+ * |__Slots[2]      -> 64 B each
+ * |  |__Generation  (uint64_t)   -> 0 if the slot was never written
+ * |  |__Count       (uint32_t)
+ * |  |__Incarnation (uint32_t)   -> of this member
+ * |  |__Checksum    (uint64_t)   -> of the fields above and records
+ * |
+ * |__Records[2][Capacity] (SharedMemberRecord, see shared_view.hpp)
+ *
+ * Every save goes to the slot not holding the latest snapshot and
+ * finishes with its header, so a crash in the middle leaves the
+ * previous snapshot intact and the torn one fails the checksum.
+ * A table outgrowing the capacity is saved into a new file of double
+ * capacity next to the current one (`<path>.grow`), which is renamed
+ * over it once synced. Loading takes the valid slot of the highest
+ * generation.
+ * Numbers are in host order, the file isn't meant to be moved between
+ * machines
+ * */
+
+class TableSnapshot {
+public:
+    struct FileHeader {
+        static constexpr uint32_t MagicValue = 0x47534E50;  // "GSNP"
+        static constexpr uint16_t Layout = 1;
+
+        uint32_t Magic;
+        uint16_t LayoutVersion;
+        uint16_t RecordSize;
+        uint32_t Capacity;
+        uint8_t Reserved[52];
+    };
+    static_assert(sizeof(FileHeader) == 64, "Snapshot header layout changed");
+
+    struct SlotHeader {
+        uint64_t Generation;
+        uint32_t Count;
+        uint32_t Incarnation;
+        uint64_t Checksum;
+        uint8_t Reserved[40];
+    };
+    static_assert(sizeof(SlotHeader) == 64, "Snapshot slot layout changed");
+
+private:
+    std::string path_;
+    void* map_;
+    std::size_t size_;
+    uint32_t capacity_;
+
+    uint64_t generation_;
+    uint64_t savedVersion_;
+    uint32_t savedIncarnation_;
+    bool saved_;
+    // Mapped file is `<path>.grow`, not yet renamed over `path`
+    bool replacing_;
+
+public:
+    // Maps the file at `path`, creating it if it's absent. A file that
+    // isn't a valid snapshot is overwritten by the first save. Throws
+    // `std::runtime_error` if the file can't be mapped
+    explicit TableSnapshot(const std::string& path, uint32_t capacity = 1024);
+    ~TableSnapshot();
+
+    TableSnapshot(const TableSnapshot&) = delete;
+    TableSnapshot& operator=(const TableSnapshot&) = delete;
+
+    // Merges the latest valid snapshot into `table` and sets this
+    // member's `incarnation`. Returns false if there is none
+    bool Load(MemberTable& table, uint32_t& incarnation) const;
+    // Writes `table` unless neither it nor `incarnation` changed since
+    // the previous save. Returns true if it did. Throws
+    // `std::runtime_error` if the file can't grow or be replaced, the
+    // previous snapshot stays mapped and usable then
+    bool Save(const MemberTable& table, uint32_t incarnation);
+
+    uint64_t Generation() const;
+
+private:
+    // Zero capacity maps the file as it is, any other one makes it a
+    // fresh snapshot file of that capacity. Replaces the current mapping
+    // only on success
+    void Map(const std::string& path, uint32_t capacity);
+    void Unmap();
+    // Index of the valid slot of the highest generation, -1 if none
+    int Latest() const;
+    bool Valid() const;
+
+    FileHeader* Header() const;
+    SlotHeader* Slot(int slot) const;
+    SharedMemberRecord* Records(int slot) const;
+    uint64_t Checksum(int slot) const;
+};
+
+#endif // HEADERS_SNAPSHOT_HPP_
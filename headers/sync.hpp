@@ -0,0 +1,195 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_SYNC_HPP_
+#define HEADERS_SYNC_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <metrics.hpp>
+#include <types.hpp>
+
+
+struct SyncConfig {
+    // Between exchanges started by this member, stretched by
+    // `1 + log2(N / 32)` in clusters above 32 members, so the whole
+    // cluster makes about the same number of exchanges per interval.
+    // Zero leaves only joins
+    std::chrono::milliseconds Interval{30000};
+    // Connect, both transfers and merge
+    std::chrono::milliseconds Timeout{5000};
+    // Exchanges served at once, the rest are refused
+    size_t MaxInbound = 4;
+    // Bigger states are refused, about 900k members by default
+    size_t MaxStateSize = 16*1024*1024;
+    // Every `ReconnectEvery`-th exchange goes to a member considered
+    // dead, so both sides of a healed partition learn about each other
+    size_t ReconnectEvery = 4;
+    // Periodic exchanges compare digests first and send only records of
+    // diverged ranges, joins always send the whole state
+    bool Digests = false;
+};
+
+
+/* Push-pull state exchange over TCP, on the same port number as gossips
+ *
+ * Full exchange (joins, `Digests` off)
+ *
+ *   initiator                            responder
+ *     |-- State(initiator's table) ------->|
+ *     |<------- State(responder's table) --|   taken before the merge
+ *     merge                                merge
+ *
+ * Anti-entropy exchange (`Digests` on)
+ *
+ *   initiator                            responder
+ *     |-- Digest(level, root) ------------>|
+ *     |<------------------------ InSync ---|   roots are equal, done
+ *     |<--- Ranges(level, range digests) --|   or they aren't
+ *     |-- Repair(diverged ranges,         >|
+ *     |          initiator's records)      |
+ *     |<---- Records(responder's records) -|   taken before the merge
+ *     merge                                merge
+ *
+ * Frame  -----------------------> 4 + 1 + Size B
+ * |
+ * |__Size (uint32_t, BE)      -> 4 B, of the rest
+ * |__Kind (uint8_t)           -> 1 B
+ * |__Payload
+ *    |__State:   Owner (Member), Table (MemberTable)
+ *    |__Digest:  Level (uint8_t), Root (uint64_t)
+ *    |__InSync:  nothing
+ *    |__Ranges:  Level (uint8_t), Digests (uint64_t[1 << Level])
+ *    |__Repair:  Level (uint8_t), Flags (bit per range), Owner, Records
+ *    |__Records: Owner (Member), Records
+ *
+ * Records are encoded as a `MemberTable`, Owner is the record of the
+ * sender itself. Numbers other than Size are in host order, as in
+ * the rest of v1 encoding. The level gives about 8 records per range
+ * of the initiator's table, so a repair sends about 8 records per
+ * diverged record, while a check of synced tables is two short frames.
+ *
+ * Received records are merged like gossips from their owners
+ * (`MemberTable::Update`), so a new member gets the whole table in one
+ * round trip and the peer learns about it at once. Runs periodically
+ * with a random alive member to repair whatever gossips missed.
+ * Works on the `io_service` thread, which is the one that changes the
+ * table, at most one outgoing exchange at a time
+ * */
+
+class PushPullSync {
+private:
+    enum class Frame : uint8_t {
+        State = 0,
+        Digest = 1,
+        InSync = 2,
+        Ranges = 3,
+        Repair = 4,
+        Records = 5
+    };
+
+    struct Session {
+        boost::asio::ip::tcp::socket Socket;
+        boost::asio::steady_timer Deadline;
+        std::array<byte, sizeof(uint32_t)> Header;
+        std::vector<byte> Local;
+        // Payload of the last received frame, its kind is the first byte
+        std::vector<byte> Remote;
+        bool Outbound;
+        bool Digest;
+        bool Done;
+
+        Session(boost::asio::io_service& ioService, bool outbound, bool digest);
+    };
+    using SessionPtr = std::shared_ptr<Session>;
+
+    boost::asio::io_service& ioService_;
+    MemberTable& table_;
+    MemberAddr self_;
+    SyncConfig config_;
+
+    boost::asio::ip::tcp::acceptor acceptor_;
+    boost::asio::steady_timer timer_;
+    boost::asio::steady_timer acceptRetry_;
+    std::vector<MemberAddr> seeds_;
+
+    bool outbound_;
+    size_t inbound_;
+    size_t started_;
+
+    size_t completed_;
+    size_t failed_;
+    size_t matched_;
+    size_t bytesSent_;
+    MetricsRegistry::Counter* conflicts_;
+
+public:
+    PushPullSync(boost::asio::io_service& ioService, MemberTable& table, const MemberAddr& self,
+                 const SyncConfig& config = SyncConfig{});
+
+    // Starts listening and periodic exchanges
+    void Start();
+    // Exchanges with the first seed that answers, seeds are also the
+    // fallback when no other member is alive
+    void Join(const std::vector<MemberAddr>& seeds);
+    // Exchanges with `peer` unless an exchange is already running.
+    // Returns false then
+    bool Exchange(const MemberAddr& peer);
+    // Conflicts found by merges are added to `counter`, the one the
+    // daemon counts gossip conflicts with
+    void CountConflicts(MetricsRegistry::Counter& counter);
+
+    size_t Completed() const;
+    size_t Failed() const;
+    // Digest exchanges that found tables equal
+    size_t Matched() const;
+    // By both sides of exchanges
+    size_t BytesSent() const;
+    // Scaled interval for the current table size
+    std::chrono::milliseconds Interval() const;
+
+private:
+    void Accept();
+    void Serve(const SessionPtr& session);
+    void Repair(const SessionPtr& session, const byte* begin, const byte* end);
+    // Tries `peers` one by one from `i` until one of them answers
+    void Dial(std::shared_ptr<std::vector<MemberAddr>> peers, size_t i, bool digest);
+    void Initiate(const SessionPtr& session);
+    void Compare(const SessionPtr& session, const byte* begin, const byte* end);
+
+    void Arm();
+    bool PickPeer(MemberAddr& peer);
+
+    // `handler(kind, begin, end)` is called with the payload of the
+    // frame once it is read
+    template < typename Handler >
+    void ReadFrame(const SessionPtr& session, Handler handler);
+    // `Local` is sent, then `handler()` is called
+    template < typename Handler >
+    void WriteFrame(const SessionPtr& session, Handler handler);
+
+    void StateFrame(std::vector<byte>& out) const;
+    void RecordsFrame(std::vector<byte>& out, Frame kind, size_t level, const std::vector<bool>& ranges) const;
+    Member Owner() const;
+    size_t DigestLevel() const;
+
+    // Merges `Owner, Records` payload part
+    bool Merge(const byte* begin, const byte* end);
+
+    void Watch(const SessionPtr& session);
+    void Finish(const SessionPtr& session, bool ok);
+};
+
+// "10.0.0.1:8005,10.0.0.2:8005", throws `std::invalid_argument` if malformed
+std::vector<MemberAddr> ParseSeeds(const std::string& seeds);
+
+#endif // HEADERS_SYNC_HPP_
@@ -17,6 +17,10 @@
 #include <arpa/inet.h>
 #include <boost/asio/ip/address.hpp>
 
+#include <codec.hpp>
+#include <wire.hpp>
+#include <member_index.hpp>
+
 
 /* Member  ------------------------> 6 + 12 = 18 B
  * |
@@ -36,45 +40,27 @@
 
 using byte = uint8_t;
 
-struct ByteTranslatable;
-
 struct MemberAddr;
 struct MemberInfo;
 struct TimeStamp;
 struct Member;
 struct MemberTable;
 struct Gossip;
+class GossipView;
 
 
-// Any class deriving this could be able converted to bytes
-struct ByteTranslatable {
-    virtual byte* Write(byte* bBegin, byte* bEnd) const = 0;
-    virtual const byte* Read(const byte* bBegin, const byte* bEnd) = 0;
-    virtual size_t ByteSize() const = 0;
-};
-
 struct JSONTranslatable {
     virtual nlohmann::json ToJSON() const = 0;
 };
 
 template < typename Type >
 byte* WriteNumberToBytes(byte* bBegin, byte* bEnd, Type number) {
-    if (bEnd - bBegin  < sizeof(number))
-        return nullptr;
-
-    *reinterpret_cast<Type*>(bBegin) = number;
-
-    return bBegin + sizeof(Type);
+    return WriteRecord(bBegin, bEnd, number);
 }
 
 template < typename Type >
 const byte* ReadNumberFromBytes(const byte* bBegin, const byte* bEnd, Type& number) {
-    if (bEnd - bBegin < sizeof(Type))
-        return nullptr;
-
-    number = *reinterpret_cast<const Type*>(bBegin);
-
-    return bBegin + sizeof(Type);
+    return ReadRecord(bBegin, bEnd, number);
 }
 
 
@@ -82,8 +68,28 @@ struct TimeStamp {
     uint32_t Time;
 };
 
+// v1 addresses are IPv4 only, 4 B in host order
+template <>
+struct Codec<boost::asio::ip::address> {
+    static constexpr size_t Size = sizeof(uint32_t);
 
-struct MemberAddr : public ByteTranslatable {
+    static void Store(byte* out, const boost::asio::ip::address& ip) {
+        Codec<uint32_t>::Store(out, ip.to_v4().to_uint());
+    }
+
+    static void Load(const byte* in, boost::asio::ip::address& ip) {
+        uint32_t number = 0;
+        Codec<uint32_t>::Load(in, number);
+        ip = boost::asio::ip::address_v4{number};
+    }
+
+    static bool Valid(const byte*) {
+        return true;
+    }
+};
+
+
+struct MemberAddr {
     boost::asio::ip::address IP;
     uint16_t Port;
 
@@ -95,15 +101,23 @@ struct MemberAddr : public ByteTranslatable {
         size_t operator()(const MemberAddr& key) const;
     };
 
-    byte* Write(byte* bBegin, byte* bEnd) const override ;
-    const byte* Read(const byte* bBegin, const byte* bEnd) override;
-    size_t ByteSize() const override;
+    // IPv4 in bits 16-47, port in bits 0-15
+    uint64_t Packed() const;
+
+    // Shortcuts to the codec (codec.hpp)
+    byte* Write(byte* bBegin, byte* bEnd) const;
+    const byte* Read(const byte* bBegin, const byte* bEnd);
+    size_t ByteSize() const;
 
     bool operator==(const MemberAddr& rhs) const;
 };
 
+template <>
+struct Layout<MemberAddr> : Fields<Field<&MemberAddr::IP>,
+                                   Field<&MemberAddr::Port>> {};
 
-struct MemberInfo : public ByteTranslatable {
+
+struct MemberInfo {
     enum State {
         Alive = 0,
         Suspicious = 1,
@@ -112,20 +126,57 @@ struct MemberInfo : public ByteTranslatable {
     } Status;
     uint32_t Incarnation;
     TimeStamp LastUpdate;
+    // Packed address of the member that suspected first, 0 if unknown.
+    // Only v2 carries it, it takes no part in comparisons
+    uint64_t Suspector = 0;
 
     MemberInfo() = default;
     MemberInfo(State status, uint32_t incarnation, TimeStamp time);
 
-    byte* Write(byte* bBegin, byte* bEnd) const override ;
-    const byte* Read(const byte* bBegin, const byte* bEnd) override;
-    size_t ByteSize() const override;
+    byte* Write(byte* bBegin, byte* bEnd) const;
+    const byte* Read(const byte* bBegin, const byte* bEnd);
+    size_t ByteSize() const;
 
     bool operator==(const MemberInfo& rhs) const;
+
+    // Higher incarnation wins, on equal incarnations the later state
+    // (Alive -> Suspicious -> Dead -> Left) wins
+    bool Overrides(const MemberInfo& rhs) const;
 };
 
+// 4 B in host order. Unknown states would win every `Overrides()`
+// comparison, and holding one in the enum is undefined behaviour, so
+// they are rejected while still a number
+template <>
+struct Codec<MemberInfo::State> {
+    static constexpr size_t Size = sizeof(uint32_t);
+
+    static void Store(byte* out, const MemberInfo::State& state) {
+        Codec<uint32_t>::Store(out, static_cast<uint32_t>(state));
+    }
+
+    // Expects bytes that passed `Valid()`
+    static void Load(const byte* in, MemberInfo::State& state) {
+        uint32_t number = 0;
+        Codec<uint32_t>::Load(in, number);
+        state = static_cast<MemberInfo::State>(number);
+    }
+
+    static bool Valid(const byte* in) {
+        uint32_t number = 0;
+        Codec<uint32_t>::Load(in, number);
+        return number <= MemberInfo::State::Left;
+    }
+};
+
+template <>
+struct Layout<MemberInfo> : Fields<Field<&MemberInfo::Status>,
+                                   Field<&MemberInfo::Incarnation>,
+                                   Field<&MemberInfo::LastUpdate>> {};
+
 
 // Here keeps all information about node
-struct Member : public ByteTranslatable, public JSONTranslatable {
+struct Member : public JSONTranslatable {
 public:
     MemberAddr Addr;
     MemberInfo Info;
@@ -136,13 +187,17 @@ public:
 
     nlohmann::json ToJSON() const override;
 
-    byte* Write(byte* bBegin, byte* bEnd) const override;
-    const byte* Read(const byte *bBegin, const byte *bEnd) override;
-    size_t ByteSize() const override;
+    byte* Write(byte* bBegin, byte* bEnd) const;
+    const byte* Read(const byte *bBegin, const byte *bEnd);
+    size_t ByteSize() const;
 
     bool operator==(const Member& rhs) const;
 };
 
+template <>
+struct Layout<Member> : Fields<Field<&Member::Addr>,
+                               Field<&Member::Info>> {};
+
 
 struct Conflict {
     MemberAddr Initiator;
@@ -150,36 +205,134 @@ struct Conflict {
 };
 
 
-class MemberTable : public ByteTranslatable , public JSONTranslatable {
+class MemberTable : public JSONTranslatable {
 private:
-    std::unordered_map<MemberAddr, size_t, MemberAddr::Hasher> index_;
+    MemberIndex index_;
     std::vector<Member> set_;
     mutable std::mt19937 rGenerator_;
 
+    // Positions taken by the current `Sample()` call are stamped with
+    // its generation, so duplicates are detected in O(1) without clearing
+    mutable std::vector<uint32_t> sampleMarks_;
+    mutable uint32_t sampleGeneration_;
+    // Reused by samples falling back to a shuffle
+    mutable std::vector<size_t> sampleCandidates_;
+
+    // Shuffled round-robin of positions in `set_` for target selection
+    std::vector<size_t> probeOrder_;
+    size_t probeCursor_;
+
+    // Last records inserted or overridden by merges, the newest one has
+    // version `version_`
+    std::deque<Member> changeLog_;
+    uint64_t version_;
+
+    // Digests of `1 << DigestDepth` leaf ranges, built by the first
+    // digest request and kept up to date after it
+    mutable std::vector<uint64_t> digests_;
+
 public:
+    // Bit set of `MemberInfo::State`s accepted by sampling
+    using StatusFilter = uint8_t;
+    static constexpr StatusFilter AnyStatus = 0x0F;
+    static constexpr StatusFilter OnlyStatus(MemberInfo::State state) {
+        return static_cast<StatusFilter>(1u << state);
+    }
+
     MemberTable();
+    // Reproducible sampling and target selection, for simulations
+    explicit MemberTable(std::mt19937::result_type seed);
 
     nlohmann::json ToJSON() const override;
 
-    byte* Write(byte* bBegin, byte* bEnd) const override;
-    const byte* Read(const byte *bBegin, const byte *bEnd) override;
-    size_t ByteSize() const override;
+    // Count (size_t) and records, each batch is checked once
+    byte* Write(byte* bBegin, byte* bEnd) const;
+    const byte* Read(const byte *bBegin, const byte *bEnd);
+    size_t ByteSize() const;
 
     size_t Size() const;
 
     void Update(const Gossip& gossip, std::deque<Conflict>& conflicts);
+    // Merges straight from the datagram bytes
+    void Update(const GossipView& gossip, std::deque<Conflict>& conflicts);
+    // Inserts member or replaces its record if `member.Info` overrides it.
+    // Returns true if the table changed
+    bool UpdateRecordIfNewer(const Member& member);
+    // Removes every record but keeps the storage, for tables refilled
+    // over and over like the ones of outgoing gossips. Version goes on,
+    // readers of the change log have to resync
+    void Clear();
+
+    // `nullptr` if member is absent
+    const Member* Find(const MemberAddr& addr) const;
+
+    // Every change made by `UpdateRecordIfNewer` increments version
+    static const size_t ChangeLogCapacity = 64*1024;
+    uint64_t Version() const;
+    // Appends records changed after `version` to `changes` and moves
+    // `version` to the current one. Returns false if some of the changes
+    // already left the log, then the reader has to resync with the table
+    bool ChangesSince(uint64_t& version, std::vector<Member>& changes) const;
+
+    // Anti-entropy digests. Records are spread over `1 << DigestDepth`
+    // leaf ranges by address hash, a range's digest is the sum of its
+    // records' hashes (address, status and incarnation), so it doesn't
+    // depend on order and is updated in O(1) on every change.
+    // Level `l` splits the table into `1 << l` ranges of leaves
+    static const size_t DigestDepth = 12;
+    uint64_t Digest() const;
+    // Writes `1 << level` range digests to `digests`
+    void RangeDigests(size_t level, std::vector<uint64_t>& digests) const;
+    static size_t Range(const MemberAddr& addr, size_t level);
+    // Appends records of ranges marked in `ranges` (one flag per range
+    // of `level`) to `out`
+    void RangeRecords(size_t level, const std::vector<bool>& ranges, std::vector<Member>& out) const;
 
     Member RandomMember() const;
     MemberTable GetSubset(size_t size) const;
+    // Writes up to `count` distinct random members passing `filter` to `out`,
+    // returns how many were written. Expected O(count) while at least a
+    // quarter of the table passes the filter, O(Size()) otherwise
+    size_t Sample(Member* out, size_t count, StatusFilter filter = AnyStatus) const;
+
+    // Members gossips could be sent to
+    static constexpr StatusFilter LiveStatus = (1u << MemberInfo::State::Alive) |
+                                               (1u << MemberInfo::State::Suspicious);
+    // Random alive or suspicious member other than `self`, for gossip
+    // dissemination. Returns false if there is nobody to pick
+    bool RandomTarget(Member& target, const MemberAddr& self) const;
+
+    // SWIM-style target selection: walks a shuffled list of members and
+    // reshuffles it after every pass. New members are put at random
+    // positions of the current pass. Dead and left members and `self` are
+    // skipped, so every other member is picked at least once per
+    // 2 * Size() - 1 calls. Returns false if there is nobody to pick.
+    // The order is kept for the failure detector alone, any other caller
+    // would make it skip members
+    bool NextProbeTarget(Member& target, const MemberAddr& self);
 
     bool operator==(const MemberTable& rhs) const;
 
+    friend struct Gossip;
+    friend class GossipPacker;
+    friend class SharedViewWriter;
+    friend class MemberTableJSON;
+    friend class TableSnapshot;
+    friend class MergeBatch;
+
     void DebugInsert(const Member& member);
     bool DebugIsExists(const Member& member) const;
 
 private:
     void Insert(const Member& member);
-    void UpdateRecordIfNewer(const Member& member);
+    // `found` is the position of the member's record, `nullptr` if absent
+    bool UpdateRecordAt(const size_t* found, const Member& member);
+
+    static uint64_t RecordHash(const Member& member);
+
+    template < typename EventsRange, typename TableRange >
+    void Merge(const Member& owner, const EventsRange& events, const TableRange& table,
+               std::deque<Conflict>& conflicts);
 };
 
 
@@ -212,20 +365,191 @@ private:
  * */
 
 
-struct Gossip : public ByteTranslatable {
+struct Gossip {
     uint16_t TTL = 0;
     Member Owner;
     Member Dest;
     std::vector<Member> Events;
     MemberTable Table;
 
+    // Failure detector messages, exist only in v2
+    MessageKind Type = MessageKind::Gossip;
+    uint32_t Sequence = 0;
+    Member Target;  // PingReq only
+
     Gossip() = default;
 
-    const byte* Read(const byte* bBegin, const byte *bEnd) override;
-    byte* Write(byte* bBegin, byte* bEnd) const override;
-    size_t ByteSize() const override;
+    // Reads both v1 and v2 (see wire.hpp)
+    const byte* Read(const byte* bBegin, const byte *bEnd);
+    // Writes v1
+    byte* Write(byte* bBegin, byte* bEnd) const;
+    size_t ByteSize() const;
+
+    // Messages other than plain gossips are always written as v2
+    byte* Write(byte* bBegin, byte* bEnd, WireVersion version) const;
+    size_t ByteSize(WireVersion version) const;
 
     bool operator==(const Gossip& rhs) const;
 };
 
+
+// Outgoing gossips of a round. `Clear()` keeps the gossips themselves,
+// so their events and tables keep the storage and the next rounds
+// build gossips without allocations
+class GossipBatch {
+private:
+    std::vector<Gossip> gossips_;
+    size_t size_;
+
+public:
+    GossipBatch();
+
+    // Appends a gossip with every field reset
+    Gossip& Next();
+    void Clear();
+
+    size_t Size() const;
+    bool Empty() const;
+
+    std::vector<Gossip>::const_iterator begin() const;
+    std::vector<Gossip>::const_iterator end() const;
+};
+
+
+// Merges a whole drain of gossips at once. Re-forwarded gossips carry
+// many copies of the same records, so they are first reduced to the
+// newest record per address, then each address is applied to the table
+// once, in the order it was first seen. The resulting table is the same
+// as after merging the gossips one by one. Table records are checked
+// for conflicts against the table as it was before the batch, so a peer
+// lagging behind another one of the same drain isn't a conflict.
+// Cleared batches are refilled without allocations
+class MergeBatch {
+private:
+    static constexpr size_t NoRecord = SIZE_MAX;
+
+    // Newer than the table records, at most one per address
+    std::vector<Member> records_;
+    std::vector<size_t> positions_; // records' positions in the table, `NoRecord` if absent
+    // Table positions having a record are stamped with the generation of
+    // the batch, so known addresses cost one table lookup, as in `Sample()`
+    std::vector<uint32_t> marks_;
+    std::vector<size_t> slots_;     // table position -> position in `records_`
+    uint32_t generation_;
+    MemberIndex absent_;            // addresses missing in the table -> position in `records_`
+    size_t added_;
+
+public:
+    MergeBatch();
+
+    void Add(const MemberTable& table, const Gossip& gossip, std::deque<Conflict>& conflicts);
+    void Add(const MemberTable& table, const GossipView& gossip, std::deque<Conflict>& conflicts);
+    // Returns the number of records which changed the table
+    size_t Apply(MemberTable& table) const;
+    void Clear();
+
+    // Distinct addresses
+    size_t Size() const;
+    // Records dropped because the table or another record of the batch
+    // is at least as new
+    size_t Coalesced() const;
+
+private:
+    template < typename EventsRange, typename TableRange >
+    void Add(const MemberTable& table, const Member& owner, const EventsRange& events,
+             const TableRange& tableRecords, std::deque<Conflict>& conflicts);
+    // Returns true if the member is staler than its record in the table
+    bool Reduce(const MemberTable& table, const Member& member);
+};
+
+
+// Non-owning view over a serialized `Gossip` of any wire version.
+// `Parse()` validates the whole datagram once, after that records are
+// decoded on the fly from the bytes, so nothing is allocated.
+// Valid while the bytes are alive
+class GossipView {
+public:
+    // Sequence of serialized `Member` records
+    class MemberRange {
+    public:
+        class Iterator {
+        private:
+            const byte* record_;
+            const byte* next_;
+            const byte* end_;
+            WireVersion version_;
+            uint32_t prevIncarnation_;
+            Member current_;
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Member;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Member*;
+            using reference = const Member&;
+
+            Iterator();
+            Iterator(const byte* record, const byte* end, WireVersion version);
+
+            const Member& operator*() const;
+            const Member* operator->() const;
+            Iterator& operator++();
+            Iterator operator++(int);
+
+            bool operator==(const Iterator& rhs) const;
+            bool operator!=(const Iterator& rhs) const;
+
+        private:
+            void Decode();
+        };
+
+    private:
+        const byte* begin_;
+        const byte* end_;
+        size_t size_;
+        WireVersion version_;
+
+    public:
+        MemberRange();
+        MemberRange(const byte* begin, const byte* end, size_t size, WireVersion version);
+
+        size_t Size() const;
+
+        Iterator begin() const;
+        Iterator end() const;
+    };
+
+private:
+    WireVersion version_;
+    uint8_t flags_;
+    uint16_t ttl_;
+    uint32_t sequence_;
+    Member target_;
+    Member owner_;
+    Member dest_;
+    MemberRange events_;
+    MemberRange table_;
+
+public:
+    GossipView();
+
+    // Returns pointer past the gossip or `nullptr` if data is unreadable
+    const byte* Parse(const byte* bBegin, const byte* bEnd);
+
+    WireVersion Version() const;
+    uint8_t Flags() const;
+    MessageKind Type() const;
+    uint32_t Sequence() const;
+    const Member& Target() const;
+    uint16_t TTL() const;
+    const Member& Owner() const;
+    const Member& Dest() const;
+    const MemberRange& Events() const;
+    const MemberRange& Table() const;
+
+private:
+    const byte* ParseV1(const byte* bBegin, const byte* bEnd);
+    const byte* ParseV2(const byte* bBegin, const byte* bEnd);
+};
+
 #endif // HEADERS_TYPES_HPP_
@@ -0,0 +1,87 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef HEADERS_WIRE_HPP_
+#define HEADERS_WIRE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+using byte = uint8_t;
+
+struct Member;
+
+
+/* Gossip v2  -------------------> 4 + ~8 * (2 + EventsSize + TableSize) B
+ * |
+ * |__Header                     -> 4 B
+ * |  |__Magic   (2 B)           -> 0x47 0xF2, never a sane v1 TTL
+ * |  |__Version (1 B)           -> 2
+ * |  |__Flags   (1 B)           -> bits 0-1 message kind
+ * |
+ * |__Sequence (varint)          -> only if kind isn't Gossip
+ * |__Target   (MemberV2)        -> only for PingReq
+ * |__TTL    (varint)
+ * |__Owner  (MemberV2)          -> incarnation delta from 0
+ * |__Dest   (MemberV2)          -> incarnation delta from 0
+ * |__Events (varint count + MemberV2[]) -> incarnations delta-chained
+ * |__Table  (varint count + MemberV2[]) -> incarnations delta-chained
+ *
+ * MemberV2  --------------------> 7 + 1..5 [+ 1..5] [+ 6] B
+ * |
+ * |__IP          (4 B, network order)
+ * |__Port        (2 B, network order)
+ * |__StateFlags  (1 B)          -> bits 0-1 state, bit 2 timestamp follows,
+ * |                                bit 3 suspector follows
+ * |__Incarnation (zigzag varint of difference with previous record)
+ * |__Time        (varint, only if flagged)
+ * |__Suspector   (4 B IP + 2 B port, network order, only if flagged)
+ *
+ * Suspector is the member that suspected first, only Suspicious records
+ * carry it and forwarders never change it
+ *
+ * Readers detect version by the magic, so v1 and v2 nodes interoperate
+ * while the writer's version is switched during rolling upgrade
+ * */
+
+enum class WireVersion : uint8_t {
+    V1 = 1,
+    V2 = 2
+};
+
+const byte WireMagic[2] = {0x47, 0xF2};
+const size_t WireHeaderSize = 4;
+
+// Failure detector messages share gossip framing
+enum class MessageKind : uint8_t {
+    Gossip = 0,
+    Ping = 1,
+    Ack = 2,
+    PingReq = 3
+};
+
+const uint8_t MessageKindMask = 0x03;
+
+enum WireStateFlags : uint8_t {
+    StateMask = 0x03,
+    HasTimestamp = 0x04,
+    HasSuspector = 0x08
+};
+
+bool IsWireV2(const byte* bBegin, const byte* bEnd);
+byte* WriteWireHeader(byte* bBegin, byte* bEnd, uint8_t flags);
+// Returns pointer past the header, `nullptr` if it is not a valid v2 header
+const byte* ReadWireHeader(const byte* bBegin, const byte* bEnd, uint8_t& flags);
+
+size_t VarintSize(uint64_t value);
+byte* WriteVarint(byte* bBegin, byte* bEnd, uint64_t value);
+const byte* ReadVarint(const byte* bBegin, const byte* bEnd, uint64_t& value);
+
+uint64_t ZigZagEncode(int64_t value);
+int64_t ZigZagDecode(uint64_t value);
+
+// `prevIncarnation` is the delta base, updated after every record
+size_t MemberV2Size(const Member& member, uint32_t& prevIncarnation);
+byte* WriteMemberV2(byte* bBegin, byte* bEnd, const Member& member, uint32_t& prevIncarnation);
+const byte* ReadMemberV2(const byte* bBegin, const byte* bEnd, Member& member, uint32_t& prevIncarnation);
+
+#endif // HEADERS_WIRE_HPP_
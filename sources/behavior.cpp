@@ -1,113 +1,153 @@
 // Copyright 2019 AndreevSemen semen.andreev00@mail.ru
 
+#include <algorithm>
+
 #include <behavior.hpp>
 
-void ThreadSaveGossipQueue::Push(const Gossip& gossip) {
-    std::lock_guard lock{mutex_};
-    queue_.push_back(gossip);
-}
+namespace {
 
-std::deque<Gossip> ThreadSaveGossipQueue::Free() {
-    std::lock_guard lock{mutex_};
+// Commits gossips to the arena, flushing it only when the next one doesn't fit
+template < typename Gossips >
+size_t WriteGossips(int sockfd, DatagramSender& sender, const Gossips& gossips, WireVersion version) {
+    size_t bytes = 0;
 
-    std::deque<Gossip> bucket{queue_};
-    queue_.clear();
+    for (const auto& gossip : gossips) {
+        if (static_cast<size_t>(sender.End() - sender.Begin()) < gossip.ByteSize(version))
+            sender.Flush(sockfd);
+
+        // Skips gossip if it doesn't fit even into the empty arena
+        byte* end = gossip.Write(sender.Begin(), sender.End(), version);
+        if (!end)
+            continue;
 
-    return std::move(bucket);
+        bytes += end - sender.Begin();
+        sender.Commit(end - sender.Begin(), {gossip.Dest.Addr.IP, gossip.Dest.Addr.Port});
+    }
+
+    return bytes;
 }
 
+} // namespace
+
+DaemonMetrics::DaemonMetrics(MetricsRegistry& registry)
+  : ReceiveCalls{registry.AddCounter("gossip_receive_calls")}
+  , ReceivedDatagrams{registry.AddCounter("gossip_received_datagrams")}
+  , ReceivedBytes{registry.AddCounter("gossip_received_bytes")}
+  , InvalidDatagrams{registry.AddCounter("gossip_invalid_datagrams")}
+  , Rounds{registry.AddCounter("gossip_rounds")}
+  , Conflicts{registry.AddCounter("gossip_conflicts")}
+  , CoalescedRecords{registry.AddCounter("gossip_coalesced_records")}
+  , SentDatagrams{registry.AddCounter("gossip_sent_datagrams")}
+  , SentBytes{registry.AddCounter("gossip_sent_bytes")}
+  , MergeLatency{registry.AddHistogram("gossip_merge_latency_us")}
+  , GenerateLatency{registry.AddHistogram("gossip_generate_latency_us")}
+  , SendLatency{registry.AddHistogram("gossip_send_latency_us")}
+  , RoundLatency{registry.AddHistogram("gossip_round_latency_us")}
+{}
+
 boost::asio::ip::udp::socket SetupSocket(boost::asio::io_service& ioService, uint16_t port) {
-    using namespace boost::asio;
-    ip::udp::socket sock(ioService, ip::udp::endpoint{ip::address_v4::any(), port});
+    return BindUDP(ioService, port);
+}
 
-    sock.set_option(boost::asio::ip::udp::socket::reuse_address{});
+std::vector<boost::asio::ip::udp::socket> SetupSockets(boost::asio::io_service& ioService, uint16_t port,
+                                                       size_t count) {
+    std::vector<boost::asio::ip::udp::socket> sockets;
+    sockets.reserve(count);
 
-    return std::move(sock);
-}
+    // A single socket doesn't need to share the port
+    for (size_t i = 0; i < count; ++i)
+        sockets.push_back(BindUDP(ioService, port, count > 1));
 
-void GossipsCatching(boost::asio::ip::udp::socket& sock, ThreadSaveGossipQueue& queue) {
-    // TODO(AndreevSemen): Change this for env var
-    ByteBuffer buffer{1500};
-    while (true) {
-        std::cout << "Gossip catching began" << std::endl;
+    return sockets;
+}
 
-        boost::asio::ip::udp::endpoint senderEp{};
-        std::cout << "Boost sock received : " << sock.receive_from(boost::asio::buffer(buffer.Begin(), buffer.Size()), senderEp) << std::endl;
+void GossipsCatching(boost::asio::ip::udp::socket& sock, PacketQueue& queue, ProtocolScheduler& scheduler,
+                     BufferPool& pool, size_t batchSize, DaemonMetrics& metrics) {
+    DatagramBatch batch{batchSize, pool.SlotSize()};
+    std::cout << "Gossip catching began" << std::endl;
 
-        Gossip gossip{};
-        // Skips gossip if data unreadable (Read() returns `nullptr`)
-        if (!gossip.Read(buffer.Begin(), buffer.End())) {
-            std::cout << "Gossip is invalid:" << std::endl;
-            continue;
+    while (true) {
+        size_t received = batch.Receive(sock.native_handle());
+        metrics.ReceiveCalls.Add();
+        metrics.ReceivedDatagrams.Add(received);
+
+        for (size_t i = 0; i < received; ++i) {
+            size_t size = batch.End(i) - batch.Begin(i);
+            metrics.ReceivedBytes.Add(size);
+
+            // Dropped ones are counted by the pool
+            Packet packet{};
+            packet.Bytes = pool.Acquire();
+            if (packet.Bytes.Empty())
+                continue;
+
+            std::copy(batch.Begin(i), batch.End(i), packet.Bytes.Begin());
+            packet.Bytes.Shrink(size);
+            packet.Sender = batch.Sender(i);
+
+            // Skips gossip if data truncated or unreadable (Parse() returns `nullptr`)
+            if (batch.Truncated(i) || !packet.View.Parse(packet.Bytes.Begin(), packet.Bytes.End())) {
+                metrics.InvalidDatagrams.Add();
+                continue;
+            }
+
+            // Dropped ones are counted by the queue
+            queue.Push(std::move(packet));
         }
 
-        queue.Push(gossip);
-
-        std::cout << gossip.Owner.ToJSON() << std::endl;
+        if (queue.Depth() != 0)
+            scheduler.Notify();
     }
 }
 
-std::deque<Conflict> UpdateTable(MemberTable& table, const std::deque<Gossip>& gossipQueue) {
-    std::deque<Conflict> conflicts;
-
-    for (const auto& gossip : gossipQueue) {
-        table.Update(gossip, conflicts);
+size_t UpdateTable(MemberTable& table, const std::vector<Packet>& packets, MergeBatch& batch,
+                   std::deque<Conflict>& conflicts) {
+    batch.Clear();
+    for (const auto& packet : packets) {
+        batch.Add(table, packet.View, conflicts);
     }
+    batch.Apply(table);
 
-    return conflicts;
+    return batch.Coalesced();
 }
 
-std::deque<Gossip> GenerateGossips(MemberTable& table, std::deque<Gossip>& queue) {
-    std::deque<Gossip> newGossips;
+void GenerateGossips(MemberTable& table, GossipPacker& packer, const std::vector<Packet>& packets, GossipBatch& out) {
+    // Only changes which were new to us are spread further
+    packer.Sync(table);
 
-    for (const auto& gossip : queue) {
-        if (queue.front().TTL == 0) {
-            queue.pop_front();
+    for (const auto& packet : packets) {
+        const GossipView& gossip = packet.View;
+        if (gossip.Type() != MessageKind::Gossip || gossip.TTL() == 0)
             continue;
-        }
 
-        Gossip newGossip{};
-        newGossip.TTL = gossip.TTL - 1;
-        newGossip.Owner = gossip.Dest;
-        newGossip.Dest = table.RandomMember();
-        newGossip.Events = gossip.Events;
-        // TODO : Change it for env var
-        newGossip.Table = table.GetSubset(4);
-
-        newGossips.push_back(newGossip);
-
-        queue.pop_front();
+        // Received gossip's destination is this member
+        Member target{};
+        if (table.RandomTarget(target, gossip.Dest().Addr))
+            packer.Pack(out.Next(), gossip.TTL() - 1, gossip.Dest(), target, table);
     }
-
-    return newGossips;
 }
 
 void SendGossip(boost::asio::ip::udp::socket& sock, const Gossip& gossip) {
-    ByteBuffer buffer{gossip.ByteSize()};
-    gossip.Write(buffer.Begin(), buffer.End());
+    // Grows to the largest gossip sent by the thread and stays so
+    thread_local ByteBuffer buffer;
+    if (buffer.Size() < gossip.ByteSize())
+        buffer = ByteBuffer{gossip.ByteSize()};
+    byte* end = gossip.Write(buffer.Begin(), buffer.End());
 
     boost::asio::ip::udp::endpoint destEp{gossip.Owner.Addr.IP, gossip.Owner.Addr.Port};
-    sock.send_to(boost::asio::buffer(buffer.Begin(), buffer.Size()), destEp);
+    sock.send_to(boost::asio::buffer(buffer.Begin(), end - buffer.Begin()), destEp);
 }
 
-void AppConnector(const MemberTable& table) {
-    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
-
-    sockaddr_un path{};
-    path.sun_family = AF_UNIX;
-    // TODO : Change it for env var
-    std::string str{"./socket.sock"};
-    std::copy(str.cbegin(), str.cend(), path.sun_path);
-
-    if (bind(sd, (sockaddr*) &path, sizeof(path)) == -1) {
-        throw std::runtime_error{
-            "Unable to open UNIX-socket"
-        };
-    }
+size_t SendGossips(boost::asio::ip::udp::socket& sock, DatagramSender& sender, const std::deque<Gossip>& gossips,
+                   WireVersion version) {
+    size_t bytes = WriteGossips(sock.native_handle(), sender, gossips, version);
+    sender.Flush(sock.native_handle());
+    return bytes;
+}
 
-    std::string json = table.ToJSON().dump();
-    while (true) {
-        std::this_thread::__sleep_for(std::chrono::seconds{5}, std::chrono::nanoseconds{0});
-        send(sd, json.c_str(), json.size(), 0);
-    }
+size_t SendGossips(boost::asio::ip::udp::socket& sock, DatagramSender& sender, const GossipBatch& gossips,
+                   WireVersion version) {
+    size_t bytes = WriteGossips(sock.native_handle(), sender, gossips, version);
+    sender.Flush(sock.native_handle());
+    return bytes;
 }
@@ -1,14 +1,52 @@
 // Copyright 2019 AndreevSemen semen.andreev00@mail.ru
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <buffer.hpp>
 
+ByteBuffer::ByteBuffer()
+  : buffer_{nullptr}
+  , size_{0}
+  , pool_{nullptr}
+{}
+
 ByteBuffer::ByteBuffer(std::size_t size)
   : buffer_{new byte[size]}
   , size_{size}
+  , pool_{nullptr}
+{}
+
+ByteBuffer::ByteBuffer(byte* buffer, std::size_t size, BufferPool* pool)
+  : buffer_{buffer}
+  , size_{size}
+  , pool_{pool}
 {}
 
 ByteBuffer::~ByteBuffer() {
-    delete[] buffer_;
+    Release();
+}
+
+ByteBuffer::ByteBuffer(ByteBuffer&& other) noexcept
+  : buffer_{other.buffer_}
+  , size_{other.size_}
+  , pool_{other.pool_}
+{
+    other.buffer_ = nullptr;
+    other.size_ = 0;
+    other.pool_ = nullptr;
+}
+
+ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other) noexcept {
+    if (this == &other)
+        return *this;
+
+    Release();
+    std::swap(buffer_, other.buffer_);
+    std::swap(size_, other.size_);
+    std::swap(pool_, other.pool_);
+
+    return *this;
 }
 
 const byte* ByteBuffer::Begin() const {
@@ -30,3 +68,90 @@ byte* ByteBuffer::End() {
 std::size_t ByteBuffer::Size() const {
     return size_;
 }
+
+bool ByteBuffer::Empty() const {
+    return buffer_ == nullptr;
+}
+
+void ByteBuffer::Shrink(std::size_t size) {
+    size_ = std::min(size, size_);
+}
+
+void ByteBuffer::Release() {
+    if (pool_)
+        pool_->Release(buffer_);
+    else
+        delete[] buffer_;
+
+    buffer_ = nullptr;
+    size_ = 0;
+    pool_ = nullptr;
+}
+
+
+BufferPool::BufferPool(std::size_t slotSize, std::size_t slotsCount)
+  : slab_{}
+  , slotSize_{slotSize}
+  , slotsCount_{slotsCount}
+  , next_{}
+  , head_{NoSlot}
+  , available_{slotsCount}
+  , exhausted_{0}
+{
+    if (slotSize == 0 || slotsCount == 0 || slotsCount >= NoSlot)
+        throw std::invalid_argument{"Buffer pool needs from 1 to 2^32 - 2 slots of non-zero size"};
+
+    slab_.reset(new byte[slotSize * slotsCount]);
+    next_.reset(new std::atomic<uint32_t>[slotsCount]);
+
+    // Slots are taken in the slab order first
+    for (std::size_t i = 0; i < slotsCount; ++i)
+        next_[i].store(i + 1 == slotsCount ? NoSlot : static_cast<uint32_t>(i + 1), std::memory_order_relaxed);
+    head_.store(0, std::memory_order_release);
+}
+
+ByteBuffer BufferPool::Acquire() {
+    uint64_t head = head_.load(std::memory_order_acquire);
+
+    while (true) {
+        auto slot = static_cast<uint32_t>(head);
+        if (slot == NoSlot) {
+            exhausted_.fetch_add(1, std::memory_order_relaxed);
+            return ByteBuffer{};
+        }
+
+        uint64_t next = (((head >> 32) + 1) << 32) | next_[slot].load(std::memory_order_relaxed);
+        if (head_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+            available_.fetch_sub(1, std::memory_order_relaxed);
+            return ByteBuffer{slab_.get() + slot * slotSize_, slotSize_, this};
+        }
+    }
+}
+
+std::size_t BufferPool::SlotSize() const {
+    return slotSize_;
+}
+
+std::size_t BufferPool::Capacity() const {
+    return slotsCount_;
+}
+
+std::size_t BufferPool::Available() const {
+    return available_.load(std::memory_order_relaxed);
+}
+
+std::size_t BufferPool::Exhausted() const {
+    return exhausted_.load(std::memory_order_relaxed);
+}
+
+void BufferPool::Release(byte* buffer) {
+    auto slot = static_cast<uint32_t>((buffer - slab_.get()) / slotSize_);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+
+    do {
+        next_[slot].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!head_.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | slot,
+                                          std::memory_order_release, std::memory_order_relaxed));
+
+    available_.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,87 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include <config.hpp>
+
+void ReadEnv(const char* name, std::string& value) {
+    const char* str = std::getenv(name);
+    if (str)
+        value = str;
+}
+
+void ReadEnv(const char* name, std::chrono::milliseconds& value, std::chrono::milliseconds minimum) {
+    std::chrono::milliseconds::rep count = value.count();
+    ReadEnv(name, count, minimum.count());
+    value = std::chrono::milliseconds{count};
+}
+
+Config Config::FromEnv() {
+    Config config;
+
+    ReadEnv("GOSSIP_PORT", config.Port);
+    // Zero batch would make receiving threads spin without reading
+    ReadEnv("GOSSIP_RECEIVE_BATCH", config.ReceiveBatchSize, std::size_t{1});
+    ReadEnv("GOSSIP_RECEIVE_THREADS", config.ReceiveThreads);
+    if (config.ReceiveThreads == 0) {
+        throw std::invalid_argument{
+            "GOSSIP_RECEIVE_THREADS must be positive"
+        };
+    }
+    ReadEnv("GOSSIP_DATAGRAM_SIZE", config.DatagramSize, std::size_t{1});
+    ReadEnv("GOSSIP_MTU", config.GossipMTU);
+    // Receive buffers would silently truncate bigger gossips
+    if (config.GossipMTU > config.DatagramSize) {
+        throw std::invalid_argument{
+            "Invalid value of GOSSIP_MTU: " + std::to_string(config.GossipMTU) +
+            " doesn't fit GOSSIP_DATAGRAM_SIZE " + std::to_string(config.DatagramSize)
+        };
+    }
+    ReadEnv("GOSSIP_RETRANSMIT_MULT", config.RetransmitMult);
+    ReadEnv("GOSSIP_QUEUE_CAPACITY", config.QueueCapacity);
+    ReadEnv("GOSSIP_SEND_ARENA", config.SendArenaSize);
+    // Gossips that don't fit the arena are never sent
+    if (config.SendArenaSize < config.GossipMTU) {
+        throw std::invalid_argument{
+            "Invalid value of GOSSIP_SEND_ARENA: " + std::to_string(config.SendArenaSize) +
+            " is below GOSSIP_MTU " + std::to_string(config.GossipMTU)
+        };
+    }
+
+    // Zero period would re-arm the round timer without ever waiting
+    ReadEnv("GOSSIP_PERIOD_MS", config.ProtocolPeriod, std::chrono::milliseconds{1});
+
+    unsigned version = static_cast<unsigned>(config.SendVersion);
+    ReadEnv("GOSSIP_WIRE_VERSION", version);
+    if (version != static_cast<unsigned>(WireVersion::V1) && version != static_cast<unsigned>(WireVersion::V2)) {
+        throw std::invalid_argument{
+            "Unsupported GOSSIP_WIRE_VERSION: " + std::to_string(version)
+        };
+    }
+    config.SendVersion = static_cast<WireVersion>(version);
+
+    ReadEnv("GOSSIP_APP_SOCKET", config.AppSocket);
+    ReadEnv("GOSSIP_APP_BACKLOG", config.AppBacklog);
+    ReadEnv("GOSSIP_SHARED_VIEW", config.SharedView);
+    ReadEnv("GOSSIP_SHARED_VIEW_CAPACITY", config.SharedViewCapacity);
+    ReadEnv("GOSSIP_SNAPSHOT", config.Snapshot);
+    ReadEnv("GOSSIP_SNAPSHOT_INTERVAL_MS", config.SnapshotInterval);
+    ReadEnv("GOSSIP_METRICS_SOCKET", config.MetricsSocket);
+    ReadEnv("GOSSIP_ADVERTISE_IP", config.AdvertiseIP);
+    ReadEnv("GOSSIP_SEEDS", config.Seeds);
+    ReadEnv("GOSSIP_PUSH_PULL_INTERVAL_MS", config.PushPullInterval);
+    ReadEnv("GOSSIP_PUSH_PULL_TIMEOUT_MS", config.PushPullTimeout);
+    ReadEnv("GOSSIP_PUSH_PULL_MAX_INBOUND", config.PushPullMaxInbound);
+    ReadEnv("GOSSIP_PUSH_PULL_MAX_BYTES", config.PushPullMaxBytes);
+    ReadEnv("GOSSIP_ANTI_ENTROPY", config.AntiEntropy);
+    ReadEnv("GOSSIP_PROBE_INTERVAL_MS", config.ProbeInterval);
+    ReadEnv("GOSSIP_PROBE_TIMEOUT_MS", config.ProbeTimeout);
+    ReadEnv("GOSSIP_INDIRECT_CHECKS", config.IndirectChecks);
+    ReadEnv("GOSSIP_SUSPICION_MULT", config.SuspicionMult);
+    ReadEnv("GOSSIP_SUSPICION_MAX_MULT", config.SuspicionMaxMult);
+    ReadEnv("GOSSIP_MAX_HEALTH_SCORE", config.MaxHealthScore);
+
+    return config;
+}
@@ -0,0 +1,225 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <istream>
+#include <random>
+
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+
+#include <connector.hpp>
+
+namespace {
+
+// Handshake is a single short line
+const std::size_t MaxRequestSize = 256;
+// Failed accepts (e.g. out of descriptors) are retried after a pause
+const std::chrono::milliseconds AcceptRetryDelay{100};
+
+} // namespace
+
+AppConnector::Client::Client(boost::asio::io_service& ioService)
+  : Socket{ioService}
+  , Request{MaxRequestSize}
+  , Outbox{}
+  , Writing{}
+  , Exempt{0}
+  , Subscribed{false}
+{}
+
+AppConnector::AppConnector(boost::asio::io_service& ioService, const MemberTable& table, const std::string& path,
+                           std::size_t maxBacklog)
+  : ioService_{ioService}
+  , table_{table}
+  , acceptor_{ioService}
+  , acceptRetry_{ioService}
+  , clients_{}
+  , maxBacklog_{maxBacklog}
+  , epoch_{std::mt19937_64{std::random_device{}()}()}
+  , version_{table.Version()}
+  , changes_{}
+  , events_{}
+  , tableJSON_{}
+{
+    using boost::asio::local::stream_protocol;
+
+    // Socket file left by the previous run would fail `bind()`
+    std::remove(path.c_str());
+
+    stream_protocol::endpoint endpoint{path};
+    acceptor_.open(endpoint.protocol());
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+}
+
+void AppConnector::Start() {
+    Accept();
+}
+
+void AppConnector::Publish() {
+    uint64_t first = version_;
+    changes_.clear();
+    bool complete = table_.ChangesSince(version_, changes_);
+
+    if (!complete) {
+        // Some changes are lost, everybody starts over
+        std::string snapshot = Snapshot();
+        auto clients = clients_;
+        for (const auto& client : clients) {
+            if (client->Subscribed)
+                Send(client, snapshot);
+        }
+        return;
+    }
+
+    if (changes_.empty())
+        return;
+
+    // Serialized once for all clients
+    events_.clear();
+    for (size_t i = 0; i < changes_.size(); ++i)
+        AppendChange(events_, changes_[i], first + i + 1);
+
+    // `Send()` may drop a client, so the list is walked over a copy
+    auto clients = clients_;
+    for (const auto& client : clients) {
+        if (client->Subscribed)
+            Send(client, events_);
+    }
+}
+
+std::size_t AppConnector::Clients() const {
+    return clients_.size();
+}
+
+uint64_t AppConnector::Epoch() const {
+    return epoch_;
+}
+
+void AppConnector::Accept() {
+    auto client = std::make_shared<Client>(ioService_);
+
+    acceptor_.async_accept(client->Socket, [this, client](const boost::system::error_code& error) {
+        if (error == boost::asio::error::operation_aborted)
+            return;
+        if (error) {
+            std::cout << "Unable to accept application client: " << error.message() << std::endl;
+            acceptRetry_.expires_from_now(AcceptRetryDelay);
+            acceptRetry_.async_wait([this](const boost::system::error_code& error) {
+                if (!error)
+                    Accept();
+            });
+            return;
+        }
+
+        clients_.push_back(client);
+        boost::asio::async_read_until(client->Socket, client->Request, '\n',
+                                      [this, client](const boost::system::error_code& error, std::size_t) {
+            if (error) {
+                Drop(client);
+                return;
+            }
+
+            Subscribe(client);
+        });
+
+        Accept();
+    });
+}
+
+void AppConnector::Subscribe(const ClientPtr& client) {
+    std::string line;
+    std::istream request{&client->Request};
+    std::getline(request, line);
+
+    // Everybody else catches up first, so the new client starts from `version_`
+    Publish();
+    client->Subscribed = true;
+
+    // Anything but a well-formed resume request gets a snapshot
+    auto json = nlohmann::json::parse(line, nullptr, false);
+    bool resume = json.is_object() &&
+                  json.find("epoch") != json.end() && json["epoch"].is_number_unsigned() &&
+                  json["epoch"].get<uint64_t>() == epoch_ &&
+                  json.find("since") != json.end() && json["since"].is_number_unsigned();
+
+    if (resume) {
+        uint64_t since = json["since"].get<uint64_t>();
+        uint64_t first = since;
+        std::vector<Member> missed;
+
+        if (since <= version_ && table_.ChangesSince(since, missed)) {
+            std::string events;
+            for (size_t i = 0; i < missed.size(); ++i)
+                AppendChange(events, missed[i], first + i + 1);
+            if (!events.empty())
+                Send(client, events);
+            return;
+        }
+    }
+
+    // Nothing is queued before it, so it's written first
+    Send(client, Snapshot(), true);
+}
+
+void AppConnector::Send(const ClientPtr& client, const std::string& data, bool exempt) {
+    size_t backlog = client->Outbox.size() + client->Writing.size() - client->Exempt;
+    if (!exempt && backlog + data.size() > maxBacklog_) {
+        Drop(client);
+        return;
+    }
+
+    if (exempt)
+        client->Exempt += data.size();
+    client->Outbox += data;
+    if (client->Writing.empty())
+        Flush(client);
+}
+
+void AppConnector::Flush(const ClientPtr& client) {
+    if (client->Outbox.empty())
+        return;
+
+    client->Writing.swap(client->Outbox);
+    boost::asio::async_write(client->Socket, boost::asio::buffer(client->Writing),
+                             [this, client](const boost::system::error_code& error, std::size_t written) {
+        client->Exempt -= std::min(client->Exempt, written);
+        client->Writing.clear();
+        if (error) {
+            Drop(client);
+            return;
+        }
+
+        Flush(client);
+    });
+}
+
+void AppConnector::Drop(const ClientPtr& client) {
+    auto it = std::find(clients_.begin(), clients_.end(), client);
+    if (it == clients_.end())
+        return;
+
+    boost::system::error_code error;
+    client->Socket.close(error);
+    clients_.erase(it);
+}
+
+std::string AppConnector::Snapshot() {
+    // Keys are sorted, as `nlohmann::json` would write them
+    std::string snapshot = "{\"epoch\":" + std::to_string(epoch_) + ",\"members\":";
+    tableJSON_.Append(snapshot, table_);
+    snapshot += ",\"type\":\"snapshot\",\"version\":" + std::to_string(version_) + "}\n";
+
+    return snapshot;
+}
+
+void AppConnector::AppendChange(std::string& out, const Member& member, uint64_t version) {
+    out += "{\"member\":";
+    AppendJSON(out, member);
+    out += ",\"type\":\"change\",\"version\":";
+    out += std::to_string(version);
+    out += "}\n";
+}
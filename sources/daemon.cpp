@@ -1,34 +1,176 @@
 // Copyright 2019 AndreevSemen semen.andreev00@mail.ru
 
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <thread>
 
 #include <behavior.hpp>
+#include <config.hpp>
+#include <connector.hpp>
+#include <detector.hpp>
+#include <metrics.hpp>
+#include <shared_writer.hpp>
+#include <snapshot.hpp>
+#include <sync.hpp>
 
 
 int main() {
+    Config config = Config::FromEnv();
+
     boost::asio::io_service ioService;
-    auto sock = SetupSocket(ioService, 8005);
+    auto sockets = SetupSockets(ioService, config.Port, config.ReceiveThreads);
+    // Any of them can send
+    auto& sock = sockets.front();
 
-    ThreadSaveGossipQueue threadSaveQueue;
-    
-    // TODO(AndreevSemen) : Change listening queue length for env variable
-    std::thread threadInput{GossipsCatching, std::ref(sock), std::ref(threadSaveQueue)};
-    threadInput.detach();
+    // Every queued packet, every one of the round being processed and
+    // one per receiving thread hold a buffer of the pool. The queue
+    // rounds its capacity up, and a round drains at most that many
+    PacketQueue packetQueue{config.QueueCapacity};
+    BufferPool packetPool{config.DatagramSize, 2*packetQueue.Capacity() + config.ReceiveThreads};
 
     MemberTable table;
+    DatagramSender sender{config.SendArenaSize};
+    GossipPacker packer{config.GossipMTU, config.SendVersion, config.RetransmitMult, !config.AntiEntropy};
+
+    DetectorConfig detectorConfig;
+    detectorConfig.ProbeInterval = config.ProbeInterval;
+    detectorConfig.ProbeTimeout = config.ProbeTimeout;
+    detectorConfig.IndirectChecks = config.IndirectChecks;
+    detectorConfig.SuspicionMult = config.SuspicionMult;
+    detectorConfig.SuspicionMaxMult = config.SuspicionMaxMult;
+    detectorConfig.MaxHealthScore = config.MaxHealthScore;
+    MemberAddr self{boost::asio::ip::address::from_string(config.AdvertiseIP), config.Port};
+    FailureDetector detector{self, detectorConfig, packer};
+    // v1 has no room for probe messages
+    bool detection = config.SendVersion == WireVersion::V2;
+
+    // Members of the previous run are known before anything is received,
+    // the own record gets a higher incarnation than the one they saw
+    std::unique_ptr<TableSnapshot> snapshot;
+    if (!config.Snapshot.empty()) {
+        snapshot.reset(new TableSnapshot{config.Snapshot});
+        uint32_t incarnation = 0;
+        if (snapshot->Load(table, incarnation))
+            detector.Restore(incarnation);
+    }
+    auto lastSnapshot = std::chrono::steady_clock::now();
+
+    SyncConfig syncConfig;
+    syncConfig.Interval = config.PushPullInterval;
+    syncConfig.Timeout = config.PushPullTimeout;
+    syncConfig.MaxInbound = config.PushPullMaxInbound;
+    syncConfig.MaxStateSize = config.PushPullMaxBytes;
+    syncConfig.Digests = config.AntiEntropy;
+    PushPullSync sync{ioService, table, self, syncConfig};
+    sync.Start();
+    // Asynchronous: rounds start right away and gossip with whoever is
+    // known so far, the seed's whole table is merged when it arrives
+    sync.Join(ParseSeeds(config.Seeds));
+
+    AppConnector connector{ioService, table, config.AppSocket, config.AppBacklog};
+    connector.Start();
 
-    //std::thread appConnector{AppConnector, std::ref(table)};
-    //appConnector.detach();
+    std::unique_ptr<SharedViewWriter> sharedView;
+    if (!config.SharedView.empty())
+        sharedView.reset(new SharedViewWriter{config.SharedView, config.SharedViewCapacity});
 
-    while (true) {
-        std::deque<Gossip> receivedGossips = threadSaveQueue.Free();
-        auto conflicts = UpdateTable(table, receivedGossips);
+    MetricsRegistry registry;
+    DaemonMetrics metrics{registry};
+    sync.CountConflicts(metrics.Conflicts);
+    registry.AddGauge("gossip_queue_depth", [&] { return packetQueue.Depth(); });
+    registry.AddGauge("gossip_queue_drops", [&] { return packetQueue.Drops(); });
+    registry.AddGauge("gossip_packet_pool_available", [&] { return packetPool.Available(); });
+    registry.AddGauge("gossip_packet_pool_exhausted", [&] { return packetPool.Exhausted(); });
+    registry.AddGauge("gossip_table_size", [&] { return table.Size(); });
+    registry.AddGauge("gossip_pending_broadcasts", [&] { return packer.Pending(); });
+    registry.AddGauge("gossip_suspicions", [&] { return detector.Suspicions(); });
+    registry.AddGauge("gossip_health_score", [&] { return detector.HealthScore(); });
+    registry.AddGauge("gossip_app_clients", [&] { return connector.Clients(); });
+    registry.AddGauge("gossip_push_pull_completed", [&] { return sync.Completed(); });
+    registry.AddGauge("gossip_push_pull_failed", [&] { return sync.Failed(); });
+    registry.AddGauge("gossip_push_pull_matched", [&] { return sync.Matched(); });
+    registry.AddGauge("gossip_push_pull_bytes", [&] { return sync.BytesSent(); });
+    if (snapshot)
+        registry.AddGauge("gossip_snapshot_generation", [&] { return snapshot->Generation(); });
+    auto& snapshotFailures = registry.AddCounter("gossip_snapshot_failures");
 
-        auto newGossips = GenerateGossips(table, receivedGossips);
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (!config.MetricsSocket.empty()) {
+        metricsServer.reset(new MetricsServer{ioService, registry, config.MetricsSocket});
+        metricsServer->Start();
+    }
+
+    // Reused round after round, so a round without news doesn't allocate
+    std::vector<Packet> receivedPackets;
+    receivedPackets.reserve(packetQueue.Capacity());
+    MergeBatch mergeBatch;
+    std::deque<Conflict> conflicts;
+    std::deque<Gossip> probes;
+    GossipBatch newGossips;
+    ProtocolScheduler scheduler{ioService, config.ProtocolPeriod, [&] {
+        ScopedTimer roundTimer{metrics.RoundLatency};
+        metrics.Rounds.Add();
+
+        receivedPackets.clear();
+        packetQueue.Drain(receivedPackets);
+
+        conflicts.clear();
+        {
+            ScopedTimer timer{metrics.MergeLatency};
+            metrics.CoalescedRecords.Add(UpdateTable(table, receivedPackets, mergeBatch, conflicts));
+        }
+        metrics.Conflicts.Add(conflicts.size());
 
-        for (const auto &gossip : newGossips) {
-            SendGossip(sock, gossip);
+        probes.clear();
+        if (detection) {
+            auto now = FailureDetector::Clock::now();
+            for (const auto& packet : receivedPackets)
+                detector.Handle(packet.View, table, now, probes);
+            detector.Tick(table, now, probes);
         }
+
+        newGossips.Clear();
+        {
+            ScopedTimer timer{metrics.GenerateLatency};
+            GenerateGossips(table, packer, receivedPackets, newGossips);
+        }
+
+        {
+            ScopedTimer timer{metrics.SendLatency};
+            metrics.SentBytes.Add(SendGossips(sock, sender, newGossips, config.SendVersion));
+            metrics.SentBytes.Add(SendGossips(sock, sender, probes, config.SendVersion));
+        }
+        metrics.SentDatagrams.Add(newGossips.Size() + probes.size());
+
+        // Local applications see changes of this round right away
+        connector.Publish();
+        if (sharedView)
+            sharedView->Publish(table);
+
+        auto now = std::chrono::steady_clock::now();
+        if (snapshot && now - lastSnapshot >= config.SnapshotInterval) {
+            // A disk problem costs the warm restart, not the membership
+            try {
+                snapshot->Save(table, detector.Self().Info.Incarnation);
+            } catch (const std::runtime_error& error) {
+                std::cout << error.what() << std::endl;
+                snapshotFailures.Add();
+            }
+            lastSnapshot = now;
+        }
+    }};
+
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        std::thread threadInput{GossipsCatching, std::ref(sockets[i]), std::ref(packetQueue),
+                                std::ref(scheduler), std::ref(packetPool), config.ReceiveBatchSize,
+                                std::ref(metrics)};
+        if (sockets.size() > 1 && !PinToCore(threadInput, i))
+            std::cout << "Unable to pin receiving thread " << i << std::endl;
+        threadInput.detach();
     }
-}
 
+    scheduler.Start();
+    ioService.run();
+}
@@ -0,0 +1,331 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <algorithm>
+#include <cmath>
+
+#include <detector.hpp>
+
+namespace {
+
+// The first suspector starts the suspicion and isn't a confirmation
+std::vector<uint64_t> Origin(const MemberInfo& info) {
+    if (info.Suspector == 0)
+        return {};
+
+    return {info.Suspector};
+}
+
+} // namespace
+
+FailureDetector::FailureDetector(const MemberAddr& self, const DetectorConfig& config, GossipPacker& packer)
+  : self_{self, MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}}
+  , config_{config}
+  , packer_{packer}
+  , nextSequence_{0}
+  , probe_{}
+  , nextProbe_{}
+  , healthScore_{0}
+  , relays_{}
+  , suspicions_{}
+  , tableVersion_{0}
+  , changes_{}
+  , helpers_{}
+{}
+
+void FailureDetector::Handle(const GossipView& message, MemberTable& table, Clock::time_point now,
+                             std::deque<Gossip>& out) {
+    if (message.Owner().Addr == self_.Addr)
+        return;
+
+    // Relayed copies of a suspicion carry its suspector, so only
+    // members that suspected on their own are counted
+    for (const auto& event : message.Events()) {
+        if (event.Info.Status == MemberInfo::State::Suspicious && Confirm(event, table, now))
+            packer_.Enqueue(event);
+    }
+
+    switch (message.Type()) {
+    case MessageKind::Ping:
+        out.push_back(Message(MessageKind::Ack, message.Sequence(), message.Owner(), table));
+        break;
+
+    case MessageKind::PingReq: {
+        // Own sequence is used, the ack is sent back with the requester's one
+        uint32_t sequence = nextSequence_++;
+        relays_[sequence] = Relay{message.Owner(), message.Sequence(), now + config_.ProbeInterval};
+        out.push_back(Message(MessageKind::Ping, sequence, message.Target(), table));
+        break;
+    }
+
+    case MessageKind::Ack: {
+        if (probe_.Active && message.Sequence() == probe_.Sequence) {
+            probe_.Acked = true;
+            break;
+        }
+
+        auto relay = relays_.find(message.Sequence());
+        if (relay == relays_.end())
+            break;
+
+        out.push_back(Message(MessageKind::Ack, relay->second.Sequence, relay->second.Requester, table));
+        relays_.erase(relay);
+        break;
+    }
+
+    case MessageKind::Gossip:
+        break;
+    }
+}
+
+void FailureDetector::Tick(MemberTable& table, Clock::time_point now, std::deque<Gossip>& out) {
+    Refute(table);
+    RunProbe(table, now, out);
+    Observe(table, now);
+    ExpireSuspicions(table, now);
+
+    for (auto it = relays_.begin(); it != relays_.end(); ) {
+        if (now >= it->second.Deadline)
+            it = relays_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void FailureDetector::Restore(uint32_t incarnation) {
+    self_.Info.Incarnation = std::max(self_.Info.Incarnation, incarnation) + 1;
+}
+
+const Member& FailureDetector::Self() const {
+    return self_;
+}
+
+size_t FailureDetector::Suspicions() const {
+    return suspicions_.size();
+}
+
+size_t FailureDetector::HealthScore() const {
+    return healthScore_;
+}
+
+Gossip FailureDetector::Message(MessageKind type, uint32_t sequence, const Member& dest, const MemberTable& table,
+                                const Member* target) {
+    Gossip message{};
+    message.Type = type;
+    message.Sequence = sequence;
+    message.Owner = self_;
+    message.Dest = dest;
+    if (target)
+        message.Target = *target;
+
+    // Changes made by the detector itself are piggybacked right away
+    packer_.Sync(table);
+    packer_.Fill(message, table);
+    return message;
+}
+
+void FailureDetector::Refute(MemberTable& table) {
+    const Member* record = table.Find(self_.Addr);
+    if (!record) {
+        table.UpdateRecordIfNewer(self_);
+        return;
+    }
+
+    // Somebody suspects us or spreads our stale record: outdate it
+    if (record->Info.Status != MemberInfo::State::Alive || record->Info.Incarnation > self_.Info.Incarnation) {
+        self_.Info.Incarnation = std::max(self_.Info.Incarnation, record->Info.Incarnation) + 1;
+        table.UpdateRecordIfNewer(self_);
+
+        // Others didn't hear from us in time, probably we are the slow one
+        if (record->Info.Status == MemberInfo::State::Suspicious)
+            RaiseHealthScore();
+    } else if (record->Info.Incarnation < self_.Info.Incarnation) {
+        // Record of the previous run
+        table.UpdateRecordIfNewer(self_);
+    }
+}
+
+void FailureDetector::RunProbe(MemberTable& table, Clock::time_point now, std::deque<Gossip>& out) {
+    if (probe_.Active && probe_.Acked) {
+        probe_.Active = false;
+        LowerHealthScore();
+    }
+
+    if (probe_.Active) {
+        auto elapsed = now - probe_.Start;
+
+        if (!probe_.Indirect && elapsed >= Scaled(config_.ProbeTimeout)) {
+            probe_.Indirect = true;
+
+            // Two extra in case `self` or the target are sampled
+            helpers_.resize(config_.IndirectChecks + 2);
+            size_t sampled = table.Sample(helpers_.data(), helpers_.size(),
+                                          MemberTable::OnlyStatus(MemberInfo::State::Alive));
+
+            size_t sent = 0;
+            for (size_t i = 0; i < sampled && sent < config_.IndirectChecks; ++i) {
+                if (helpers_[i].Addr == self_.Addr || helpers_[i].Addr == probe_.Target.Addr)
+                    continue;
+
+                out.push_back(Message(MessageKind::PingReq, probe_.Sequence, helpers_[i], table, &probe_.Target));
+                ++sent;
+            }
+        }
+
+        if (elapsed < Scaled(config_.ProbeInterval))
+            return;
+
+        Suspect(probe_.Target, table, now);
+        probe_.Active = false;
+        RaiseHealthScore();
+    }
+
+    if (now < nextProbe_)
+        return;
+
+    Member target{};
+    if (!table.NextProbeTarget(target, self_.Addr))
+        return;
+
+    probe_.Target = target;
+    probe_.Sequence = nextSequence_++;
+    probe_.Start = now;
+    probe_.Indirect = false;
+    probe_.Acked = false;
+    probe_.Active = true;
+    nextProbe_ = now + Scaled(config_.ProbeInterval);
+
+    out.push_back(Message(MessageKind::Ping, probe_.Sequence, target, table));
+}
+
+void FailureDetector::Suspect(const Member& target, MemberTable& table, Clock::time_point now) {
+    const Member* record = table.Find(target.Addr);
+    // Dead or left, or the member has refuted meanwhile
+    if (!record || record->Info.Incarnation != target.Info.Incarnation)
+        return;
+
+    Member suspect = *record;
+    suspect.Info.Suspector = self_.Addr.Packed();
+
+    // Somebody else suspects it already, this is a confirmation
+    if (record->Info.Status == MemberInfo::State::Suspicious) {
+        if (Confirm(suspect, table, now))
+            packer_.Enqueue(suspect);
+        return;
+    }
+
+    if (record->Info.Status != MemberInfo::State::Alive)
+        return;
+
+    suspect.Info.Status = MemberInfo::State::Suspicious;
+    table.UpdateRecordIfNewer(suspect);
+}
+
+bool FailureDetector::Confirm(const Member& suspect, const MemberTable& table, Clock::time_point now) {
+    if (suspect.Addr == self_.Addr || suspect.Info.Suspector == 0)
+        return false;
+
+    // Only a suspicion the table still agrees with is confirmed
+    const Member* record = table.Find(suspect.Addr);
+    if (!record || record->Info.Status != MemberInfo::State::Suspicious ||
+        record->Info.Incarnation != suspect.Info.Incarnation)
+        return false;
+
+    auto it = suspicions_.find(suspect.Addr);
+    if (it == suspicions_.end() || it->second.Incarnation != suspect.Info.Incarnation) {
+        Suspicion suspicion{suspect.Info.Incarnation, now, Origin(record->Info)};
+        it = suspicions_.insert_or_assign(suspect.Addr, std::move(suspicion)).first;
+    }
+
+    // The origin and `IndirectChecks` confirmations are all that matter
+    auto& suspectors = it->second.Suspectors;
+    if (suspectors.size() > config_.IndirectChecks)
+        return false;
+
+    uint64_t suspector = suspect.Info.Suspector;
+    if (std::find(suspectors.cbegin(), suspectors.cend(), suspector) != suspectors.cend())
+        return false;
+
+    suspectors.push_back(suspector);
+    return true;
+}
+
+void FailureDetector::Observe(const MemberTable& table, Clock::time_point now) {
+    changes_.clear();
+    if (!table.ChangesSince(tableVersion_, changes_)) {
+        // Some changes are lost, so every suspected member is rescanned.
+        // Already tracked ones keep their timers
+        changes_.resize(table.Size());
+        changes_.resize(table.Sample(changes_.data(), changes_.size(),
+                                     MemberTable::OnlyStatus(MemberInfo::State::Suspicious)));
+    }
+
+    for (const auto& change : changes_) {
+        if (change.Addr == self_.Addr)
+            continue;
+
+        if (change.Info.Status != MemberInfo::State::Suspicious) {
+            suspicions_.erase(change.Addr);
+            continue;
+        }
+
+        auto it = suspicions_.find(change.Addr);
+        if (it == suspicions_.end() || it->second.Incarnation != change.Info.Incarnation)
+            suspicions_[change.Addr] = Suspicion{change.Info.Incarnation, now, Origin(change.Info)};
+    }
+}
+
+void FailureDetector::ExpireSuspicions(MemberTable& table, Clock::time_point now) {
+    for (auto it = suspicions_.begin(); it != suspicions_.end(); ) {
+        const Member* record = table.Find(it->first);
+        if (!record || record->Info.Status != MemberInfo::State::Suspicious ||
+            record->Info.Incarnation != it->second.Incarnation) {
+            it = suspicions_.erase(it);
+            continue;
+        }
+
+        const auto& suspectors = it->second.Suspectors;
+        size_t confirmations = suspectors.empty() ? 0 : suspectors.size() - 1;
+        if (now - it->second.Start < SuspicionTimeout(table.Size(), confirmations)) {
+            ++it;
+            continue;
+        }
+
+        Member dead = *record;
+        dead.Info.Status = MemberInfo::State::Dead;
+        dead.Info.Suspector = 0;
+        table.UpdateRecordIfNewer(dead);
+        it = suspicions_.erase(it);
+    }
+}
+
+void FailureDetector::RaiseHealthScore() {
+    if (healthScore_ < config_.MaxHealthScore)
+        ++healthScore_;
+}
+
+void FailureDetector::LowerHealthScore() {
+    if (healthScore_ > 0)
+        --healthScore_;
+}
+
+FailureDetector::Clock::duration FailureDetector::Scaled(std::chrono::milliseconds timeout) const {
+    return timeout * (healthScore_ + 1);
+}
+
+FailureDetector::Clock::duration FailureDetector::SuspicionTimeout(size_t clusterSize, size_t confirmations) const {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    double scale = std::max(1.0, std::log10(static_cast<double>(clusterSize) + 1));
+    Milliseconds minTimeout = config_.ProbeInterval * (config_.SuspicionMult * scale);
+    Milliseconds maxTimeout = minTimeout * static_cast<double>(std::max<size_t>(config_.SuspicionMaxMult, 1));
+
+    // max - (max - min) * log(C + 1) / log(K + 1)
+    double fraction = 1.0;
+    if (config_.IndirectChecks > 0) {
+        fraction = std::log(static_cast<double>(confirmations) + 1) /
+                   std::log(static_cast<double>(config_.IndirectChecks) + 1);
+    }
+    Milliseconds timeout = maxTimeout - (maxTimeout - minTimeout) * std::min(fraction, 1.0);
+
+    return std::chrono::duration_cast<Clock::duration>(std::max(timeout, minTimeout));
+}
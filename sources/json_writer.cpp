@@ -0,0 +1,110 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <charconv>
+#include <cstring>
+
+#include <json_writer.hpp>
+
+namespace {
+
+void AppendNumber(std::string& out, uint64_t number) {
+    char digits[20];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr);
+}
+
+void AppendIP(std::string& out, const boost::asio::ip::address& ip) {
+    if (!ip.is_v4()) {
+        // IPv6 text has no special characters either
+        out += ip.to_string();
+        return;
+    }
+
+    auto bytes = ip.to_v4().to_bytes();
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        if (i != 0)
+            out += '.';
+        AppendNumber(out, bytes[i]);
+    }
+}
+
+bool SameRecord(const Member& lhs, const Member& rhs) {
+    return lhs.Addr == rhs.Addr &&
+           lhs.Info.Status == rhs.Info.Status &&
+           lhs.Info.Incarnation == rhs.Info.Incarnation;
+}
+
+} // namespace
+
+const char* StatusName(MemberInfo::State status) {
+    switch (status) {
+        case MemberInfo::State::Alive:
+            return "alive";
+        case MemberInfo::State::Suspicious:
+            return "suspicious";
+        case MemberInfo::State::Dead:
+            return "dead";
+        case MemberInfo::State::Left:
+            return "left";
+    }
+
+    return "";
+}
+
+void AppendJSON(std::string& out, const Member& member) {
+    // Keys in the order `nlohmann::json` dumps them
+    out += "{\"addr\":{\"IP\":\"";
+    AppendIP(out, member.Addr.IP);
+    out += "\",\"port\":";
+    AppendNumber(out, member.Addr.Port);
+    out += "},\"info\":{\"incarnation\":";
+    AppendNumber(out, member.Info.Incarnation);
+    out += ",\"status\":\"";
+    out += StatusName(member.Info.Status);
+    out += "\"}}";
+}
+
+const std::string& MemberTableJSON::Dump(const MemberTable& table) {
+    out_.clear();
+    Append(out_, table);
+    return out_;
+}
+
+void MemberTableJSON::Append(std::string& out, const MemberTable& table) {
+    out.reserve(out.size() + table.Size() * MaxSize / 2);
+
+    out += '[';
+    for (std::size_t i = 0; i < table.Size(); ++i) {
+        if (i != 0)
+            out += ',';
+
+        AppendMember(out, table, i);
+    }
+    out += ']';
+}
+
+void MemberTableJSON::AppendMember(std::string& out, const MemberTable& table, std::size_t i) {
+    const Member& member = table.set_[i];
+    if (i >= fragments_.size())
+        fragments_.resize(table.Size());
+
+    Fragment& fragment = fragments_[i];
+    if (fragment.Size != 0 && SameRecord(fragment.Cached, member)) {
+        out.append(fragment.Text, fragment.Size);
+        return;
+    }
+
+    scratch_.clear();
+    AppendJSON(scratch_, member);
+    out += scratch_;
+
+    // Texts not fitting the cache are rebuilt every time
+    if (scratch_.size() > MaxSize) {
+        fragment.Size = 0;
+        return;
+    }
+
+    fragment.Cached = member;
+    fragment.Size = static_cast<uint8_t>(scratch_.size());
+    std::memcpy(fragment.Text, scratch_.data(), scratch_.size());
+}
@@ -0,0 +1,198 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <algorithm>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <member_index.hpp>
+
+namespace {
+
+const int8_t Empty = -128;
+const int8_t Deleted = -2;
+const size_t NotFound = static_cast<size_t>(-1);
+
+int8_t Tag(uint64_t hash) {
+    return static_cast<int8_t>(hash & 0x7F);
+}
+
+size_t GroupOf(uint64_t hash, size_t groupMask) {
+    return static_cast<size_t>(hash >> 7) & groupMask;
+}
+
+// Bit `i` is set if control byte `i` of the group equals `value`
+uint32_t MatchGroup(const int8_t* group, int8_t value) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < MemberIndex::GroupSize; ++i) {
+        if (group[i] == value)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Empty or deleted slots have the sign bit set
+uint32_t MatchFree(const int8_t* group) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < MemberIndex::GroupSize; ++i) {
+        if (group[i] < 0)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+unsigned LowestBit(uint32_t mask) {
+    return static_cast<unsigned>(__builtin_ctz(mask));
+}
+
+} // namespace
+
+MemberIndex::MemberIndex()
+  : control_{}
+  , slots_{}
+  , groupMask_{0}
+  , size_{0}
+  , growthLeft_{0}
+{}
+
+const size_t* MemberIndex::Find(uint64_t key) const {
+    if (size_ == 0)
+        return nullptr;
+
+    size_t slot = FindSlot(key, Mix(key));
+    return slot == NotFound ? nullptr : &slots_[slot].Value;
+}
+
+size_t* MemberIndex::Find(uint64_t key) {
+    return const_cast<size_t*>(const_cast<const MemberIndex*>(this)->Find(key));
+}
+
+bool MemberIndex::Insert(uint64_t key, size_t value) {
+    if (growthLeft_ == 0) {
+        // Grows only if the table is really full, not just cluttered with tombstones
+        size_t groups = control_.empty() ? 1 : groupMask_ + 1;
+        if (size_ >= groups*GroupSize*7/16)
+            groups *= 2;
+        Rehash(groups);
+    }
+
+    uint64_t hash = Mix(key);
+    if (size_ != 0 && FindSlot(key, hash) != NotFound)
+        return false;
+
+    size_t group = GroupOf(hash, groupMask_);
+    for (size_t step = 1; ; ++step) {
+        const int8_t* ctrl = control_.data() + group*GroupSize;
+        uint32_t free = MatchFree(ctrl);
+        if (free) {
+            size_t slot = group*GroupSize + LowestBit(free);
+            if (control_[slot] == Empty)
+                --growthLeft_;
+
+            control_[slot] = Tag(hash);
+            slots_[slot] = Slot{key, value};
+            ++size_;
+            return true;
+        }
+
+        group = (group + step) & groupMask_;
+    }
+}
+
+bool MemberIndex::Erase(uint64_t key) {
+    if (size_ == 0)
+        return false;
+
+    size_t slot = FindSlot(key, Mix(key));
+    if (slot == NotFound)
+        return false;
+
+    // Tombstone keeps probe chains passing through this group intact
+    control_[slot] = Deleted;
+    --size_;
+    return true;
+}
+
+void MemberIndex::Reserve(size_t size) {
+    size_t groups = control_.empty() ? 1 : groupMask_ + 1;
+    while (groups*GroupSize*7/8 < size)
+        groups *= 2;
+
+    if (control_.empty() || groups != groupMask_ + 1)
+        Rehash(groups);
+}
+
+void MemberIndex::Clear() {
+    std::fill(control_.begin(), control_.end(), Empty);
+    size_ = 0;
+    growthLeft_ = control_.size()*7/8;
+}
+
+size_t MemberIndex::Size() const {
+    return size_;
+}
+
+size_t MemberIndex::Capacity() const {
+    return control_.size();
+}
+
+uint64_t MemberIndex::Mix(uint64_t key) {
+    // MurmurHash3 fmix64
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+size_t MemberIndex::FindSlot(uint64_t key, uint64_t hash) const {
+    int8_t tag = Tag(hash);
+    size_t group = GroupOf(hash, groupMask_);
+
+    // Every group is visited once at most
+    for (size_t step = 1; step <= groupMask_ + 1; ++step) {
+        const int8_t* ctrl = control_.data() + group*GroupSize;
+
+        for (uint32_t match = MatchGroup(ctrl, tag); match; match &= match - 1) {
+            size_t slot = group*GroupSize + LowestBit(match);
+            if (slots_[slot].Key == key)
+                return slot;
+        }
+
+        if (MatchGroup(ctrl, Empty))
+            return NotFound;
+
+        group = (group + step) & groupMask_;
+    }
+
+    return NotFound;
+}
+
+void MemberIndex::Rehash(size_t groups) {
+    std::vector<int8_t> oldControl{std::move(control_)};
+    std::vector<Slot> oldSlots{std::move(slots_)};
+
+    control_.assign(groups*GroupSize, Empty);
+    slots_.assign(groups*GroupSize, Slot{0, 0});
+    groupMask_ = groups - 1;
+    size_ = 0;
+    growthLeft_ = groups*GroupSize*7/8;
+
+    for (size_t i = 0; i < oldControl.size(); ++i) {
+        if (oldControl[i] >= 0)
+            Insert(oldSlots[i].Key, oldSlots[i].Value);
+    }
+}
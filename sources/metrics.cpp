@@ -0,0 +1,189 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+#include <boost/asio/write.hpp>
+
+#include <metrics.hpp>
+
+namespace {
+
+std::atomic<std::size_t> nextThreadSlot{0};
+// Failed accepts (e.g. out of descriptors) are retried after a pause
+const std::chrono::milliseconds AcceptRetryDelay{100};
+
+} // namespace
+
+MetricsRegistry::Counter::Counter()
+  : slots_{new Slot[MaxThreads]}
+{}
+
+void MetricsRegistry::Counter::Add(uint64_t value) {
+    slots_[ThreadSlot()].Value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricsRegistry::Counter::Value() const {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < MaxThreads; ++i)
+        value += slots_[i].Value.load(std::memory_order_relaxed);
+
+    return value;
+}
+
+MetricsRegistry::Histogram::Histogram()
+  : slots_{new Slot[MaxThreads]}
+{}
+
+void MetricsRegistry::Histogram::Record(std::chrono::nanoseconds latency) {
+    auto micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+
+    // Bit length of `micros - 1` is the first power of two not below, so
+    // exact powers of two land in their own `le` bucket
+    std::size_t bucket = 0;
+    for (uint64_t value = micros == 0 ? 0 : micros - 1; value != 0 && bucket < BucketsCount - 1; value >>= 1)
+        ++bucket;
+
+    Slot& slot = slots_[ThreadSlot()];
+    slot.Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    slot.Sum.fetch_add(micros, std::memory_order_relaxed);
+}
+
+uint64_t MetricsRegistry::Histogram::Bucket(std::size_t i) const {
+    uint64_t count = 0;
+    for (std::size_t slot = 0; slot < MaxThreads; ++slot)
+        count += slots_[slot].Buckets[i].load(std::memory_order_relaxed);
+
+    return count;
+}
+
+uint64_t MetricsRegistry::Histogram::Count() const {
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < BucketsCount; ++i)
+        count += Bucket(i);
+
+    return count;
+}
+
+uint64_t MetricsRegistry::Histogram::Sum() const {
+    uint64_t sum = 0;
+    for (std::size_t slot = 0; slot < MaxThreads; ++slot)
+        sum += slots_[slot].Sum.load(std::memory_order_relaxed);
+
+    return sum;
+}
+
+MetricsRegistry::Counter& MetricsRegistry::AddCounter(const std::string& name) {
+    counters_.push_back(Named<Counter>{name, Counter{}});
+    return counters_.back().Value;
+}
+
+MetricsRegistry::Histogram& MetricsRegistry::AddHistogram(const std::string& name) {
+    histograms_.push_back(Named<Histogram>{name, Histogram{}});
+    return histograms_.back().Value;
+}
+
+void MetricsRegistry::AddGauge(const std::string& name, Gauge gauge) {
+    gauges_.push_back(Named<Gauge>{name, std::move(gauge)});
+}
+
+std::string MetricsRegistry::Snapshot() const {
+    std::ostringstream out;
+
+    for (const auto& counter : counters_)
+        out << counter.Name << ' ' << counter.Value.Value() << '\n';
+
+    for (const auto& gauge : gauges_)
+        out << gauge.Name << ' ' << gauge.Value() << '\n';
+
+    for (const auto& histogram : histograms_) {
+        uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < Histogram::BucketsCount; ++i) {
+            cumulative += histogram.Value.Bucket(i);
+
+            out << histogram.Name << "_bucket{le=\"";
+            if (i + 1 < Histogram::BucketsCount)
+                out << (uint64_t{1} << i);
+            else
+                out << "+Inf";
+            out << "\"} " << cumulative << '\n';
+        }
+        out << histogram.Name << "_sum " << histogram.Value.Sum() << '\n';
+        out << histogram.Name << "_count " << cumulative << '\n';
+    }
+
+    return out.str();
+}
+
+std::size_t MetricsRegistry::ThreadSlot() {
+    // Threads above the limit share slots, which is still correct
+    thread_local std::size_t slot = nextThreadSlot.fetch_add(1, std::memory_order_relaxed) % MaxThreads;
+    return slot;
+}
+
+
+ScopedTimer::ScopedTimer(MetricsRegistry::Histogram& histogram)
+  : histogram_{histogram}
+  , start_{std::chrono::steady_clock::now()}
+{}
+
+ScopedTimer::~ScopedTimer() {
+    histogram_.Record(std::chrono::steady_clock::now() - start_);
+}
+
+
+MetricsServer::Client::Client(boost::asio::io_service& ioService)
+  : Socket{ioService}
+  , Snapshot{}
+{}
+
+MetricsServer::MetricsServer(boost::asio::io_service& ioService, const MetricsRegistry& registry,
+                             const std::string& path)
+  : ioService_{ioService}
+  , registry_{registry}
+  , acceptor_{ioService}
+  , acceptRetry_{ioService}
+{
+    using boost::asio::local::stream_protocol;
+
+    // Socket file left by the previous run would fail `bind()`
+    std::remove(path.c_str());
+
+    stream_protocol::endpoint endpoint{path};
+    acceptor_.open(endpoint.protocol());
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+}
+
+void MetricsServer::Start() {
+    Accept();
+}
+
+void MetricsServer::Accept() {
+    auto client = std::make_shared<Client>(ioService_);
+
+    acceptor_.async_accept(client->Socket, [this, client](const boost::system::error_code& error) {
+        if (error == boost::asio::error::operation_aborted)
+            return;
+        if (error) {
+            std::cout << "Unable to accept metrics client: " << error.message() << std::endl;
+            acceptRetry_.expires_from_now(AcceptRetryDelay);
+            acceptRetry_.async_wait([this](const boost::system::error_code& error) {
+                if (!error)
+                    Accept();
+            });
+            return;
+        }
+
+        // The snapshot lives with the client until it's written
+        client->Snapshot = registry_.Snapshot();
+        boost::asio::async_write(client->Socket, boost::asio::buffer(client->Snapshot),
+                                 [client](const boost::system::error_code&, std::size_t) {
+            boost::system::error_code closeError;
+            client->Socket.close(closeError);
+        });
+
+        Accept();
+    });
+}
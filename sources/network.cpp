@@ -0,0 +1,293 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <network.hpp>
+
+// Missing in older libc headers
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace {
+
+boost::asio::ip::udp::endpoint ToEndpoint(const sockaddr_storage& storage) {
+    using namespace boost::asio;
+
+    if (storage.ss_family == AF_INET) {
+        const auto& addr = reinterpret_cast<const sockaddr_in&>(storage);
+        return ip::udp::endpoint{ip::address_v4{ntohl(addr.sin_addr.s_addr)},
+                                 ntohs(addr.sin_port)};
+    }
+    if (storage.ss_family == AF_INET6) {
+        const auto& addr = reinterpret_cast<const sockaddr_in6&>(storage);
+        ip::address_v6::bytes_type bytes;
+        std::memcpy(bytes.data(), addr.sin6_addr.s6_addr, bytes.size());
+        return ip::udp::endpoint{ip::address_v6{bytes, addr.sin6_scope_id},
+                                 ntohs(addr.sin6_port)};
+    }
+
+    return ip::udp::endpoint{};
+}
+
+} // namespace
+
+
+DatagramBatch::DatagramBatch(std::size_t slotsCount, std::size_t slotSize)
+  : buffer_{slotsCount*slotSize}
+  , slotSize_{slotSize}
+  , headers_(slotsCount)
+  , iovecs_(slotsCount)
+  , senders_(slotsCount)
+  , received_{0}
+  , totalCalls_{0}
+  , totalDatagrams_{0}
+{
+    for (std::size_t i = 0; i < slotsCount; ++i) {
+        iovecs_[i].iov_base = buffer_.Begin() + i*slotSize_;
+        iovecs_[i].iov_len = slotSize_;
+
+        std::memset(&headers_[i], 0, sizeof(mmsghdr));
+        headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+        headers_[i].msg_hdr.msg_iovlen = 1;
+        headers_[i].msg_hdr.msg_name = &senders_[i];
+        headers_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    }
+}
+
+std::size_t DatagramBatch::Receive(int sockfd) {
+    // `recvmmsg` overwrites name lengths with the real ones
+    for (auto& header : headers_) {
+        header.msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        header.msg_hdr.msg_flags = 0;
+    }
+
+    int count = recvmmsg(sockfd, headers_.data(), headers_.size(), MSG_WAITFORONE, nullptr);
+    if (count == -1) {
+        received_ = 0;
+        if (errno == EINTR)
+            return 0;
+
+        throw std::runtime_error{
+            std::string{"Unable to receive datagrams: "} + std::strerror(errno)
+        };
+    }
+
+    received_ = static_cast<std::size_t>(count);
+    ++totalCalls_;
+    totalDatagrams_ += received_;
+
+    return received_;
+}
+
+std::size_t DatagramBatch::Capacity() const {
+    return headers_.size();
+}
+
+std::size_t DatagramBatch::Size() const {
+    return received_;
+}
+
+const byte* DatagramBatch::Begin(std::size_t i) const {
+    return buffer_.Begin() + i*slotSize_;
+}
+
+const byte* DatagramBatch::End(std::size_t i) const {
+    std::size_t length = headers_[i].msg_len;
+    return Begin(i) + (length < slotSize_ ? length : slotSize_);
+}
+
+bool DatagramBatch::Truncated(std::size_t i) const {
+    return (headers_[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+}
+
+boost::asio::ip::udp::endpoint DatagramBatch::Sender(std::size_t i) const {
+    return ToEndpoint(senders_[i]);
+}
+
+std::size_t DatagramBatch::TotalCalls() const {
+    return totalCalls_;
+}
+
+std::size_t DatagramBatch::TotalDatagrams() const {
+    return totalDatagrams_;
+}
+
+
+DatagramSender::DatagramSender(std::size_t arenaSize, bool gso)
+  : arena_{arenaSize}
+  , used_{0}
+  , pending_{}
+  , gso_{gso}
+  , totalCalls_{0}
+  , totalDatagrams_{0}
+{}
+
+byte* DatagramSender::Begin() {
+    return arena_.Begin() + used_;
+}
+
+byte* DatagramSender::End() {
+    return arena_.End();
+}
+
+void DatagramSender::Commit(std::size_t size, const boost::asio::ip::udp::endpoint& dest) {
+    pending_.push_back(Datagram{used_, size, dest});
+    used_ += size;
+}
+
+std::size_t DatagramSender::PendingCount() const {
+    return pending_.size();
+}
+
+void DatagramSender::Flush(int sockfd) {
+    std::size_t messages = Prepare(0);
+    std::size_t done = 0;
+
+    while (done < messages) {
+        int count = sendmmsg(sockfd, headers_.data() + done, messages - done, 0);
+        ++totalCalls_;
+
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+
+            // Device or kernel can't segment: resend the rest one by one
+            if (gso_ && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                gso_ = false;
+                messages = done + Prepare(firsts_[done]);
+                continue;
+            }
+
+            // UDP is lossy anyway, so the failed message is just dropped
+            ++done;
+            continue;
+        }
+
+        done += static_cast<std::size_t>(count);
+    }
+
+    totalDatagrams_ += pending_.size();
+    pending_.clear();
+    used_ = 0;
+}
+
+bool DatagramSender::GSOEnabled() const {
+    return gso_;
+}
+
+std::size_t DatagramSender::TotalCalls() const {
+    return totalCalls_;
+}
+
+std::size_t DatagramSender::TotalDatagrams() const {
+    return totalDatagrams_;
+}
+
+std::size_t DatagramSender::Prepare(std::size_t first) {
+    // Kernel limits for one GSO super-datagram
+    const std::size_t maxSegments = 64;
+    const std::size_t maxGSOBytes = 65000;
+    const std::size_t controlWords = CMSG_SPACE(sizeof(uint16_t)) / sizeof(uint64_t) + 1;
+
+    // At most one message per datagram; sized up front so that headers
+    // never point into reallocated storage
+    if (headers_.size() < pending_.size()) {
+        headers_.resize(pending_.size());
+        iovecs_.resize(pending_.size());
+        dests_.resize(pending_.size());
+        controls_.resize(pending_.size()*controlWords);
+    }
+
+    // Headers before `first` are already sent, so only the tail is rebuilt
+    std::size_t message = 0;
+    while (message < firsts_.size() && firsts_[message] < first)
+        ++message;
+    std::size_t base = message;
+    firsts_.resize(pending_.size());
+
+    for (std::size_t i = first; i < pending_.size(); ++message) {
+        std::size_t segment = pending_[i].Size;
+        std::size_t last = i + 1;
+        if (gso_) {
+            while (last < pending_.size() &&
+                   last - i < maxSegments &&
+                   pending_[last].Dest == pending_[i].Dest &&
+                   pending_[last].Size <= segment &&
+                   pending_[last].Offset + pending_[last].Size - pending_[i].Offset <= maxGSOBytes) {
+                // Only the last segment may be shorter
+                bool shorter = pending_[last].Size < segment;
+                ++last;
+                if (shorter)
+                    break;
+            }
+        }
+
+        firsts_[message] = i;
+
+        const auto& endpoint = pending_[i].Dest;
+        std::memcpy(&dests_[message], endpoint.data(), endpoint.size());
+
+        iovecs_[message].iov_base = arena_.Begin() + pending_[i].Offset;
+        iovecs_[message].iov_len = pending_[last - 1].Offset + pending_[last - 1].Size - pending_[i].Offset;
+
+        auto& header = headers_[message];
+        std::memset(&header, 0, sizeof(mmsghdr));
+        header.msg_hdr.msg_name = &dests_[message];
+        header.msg_hdr.msg_namelen = endpoint.size();
+        header.msg_hdr.msg_iov = &iovecs_[message];
+        header.msg_hdr.msg_iovlen = 1;
+
+        if (last - i > 1) {
+            header.msg_hdr.msg_control = &controls_[message*controlWords];
+            header.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+            cmsghdr* control = CMSG_FIRSTHDR(&header.msg_hdr);
+            control->cmsg_level = SOL_UDP;
+            control->cmsg_type = UDP_SEGMENT;
+            control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = static_cast<uint16_t>(segment);
+            std::memcpy(CMSG_DATA(control), &segmentSize, sizeof(segmentSize));
+        }
+
+        i = last;
+    }
+
+    firsts_.resize(message);
+    return message - base;
+}
+
+
+boost::asio::ip::udp::socket BindUDP(boost::asio::io_service& ioService, uint16_t port, bool reusePort) {
+    using namespace boost::asio;
+
+    // Options must be set between `open()` and `bind()`
+    ip::udp::socket sock{ioService};
+    sock.open(ip::udp::v4());
+    sock.set_option(ip::udp::socket::reuse_address{true});
+    if (reusePort)
+        sock.set_option(ReusePort{true});
+    sock.bind(ip::udp::endpoint{ip::address_v4::any(), port});
+
+    return sock;
+}
+
+bool PinToCore(std::thread& thread, std::size_t core) {
+    std::size_t cores = std::thread::hardware_concurrency();
+    if (cores == 0)
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % cores, &set);
+
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+}
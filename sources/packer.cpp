@@ -0,0 +1,174 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <packer.hpp>
+
+namespace {
+
+// The shortest record of the version, used to estimate how many table
+// samples could still fit
+size_t MinRecordSize(WireVersion version) {
+    if (version == WireVersion::V1)
+        return EncodedSize<Member>;
+
+    // Address, state byte and one-byte incarnation delta
+    return sizeof(uint32_t) + sizeof(uint16_t) + 1 + 1;
+}
+
+} // namespace
+
+GossipPacker::GossipPacker(size_t mtu, WireVersion version, size_t retransmitMult, bool samples)
+  : broadcasts_{}
+  , index_{}
+  , mtu_{mtu}
+  , version_{version}
+  , retransmitMult_{retransmitMult}
+  , samples_{samples}
+  , order_{}
+  , sampled_{}
+  , tableVersion_{0}
+  , changes_{}
+{}
+
+void GossipPacker::Enqueue(const Member& event) {
+    auto found = index_.find(event.Addr);
+    if (found == index_.end()) {
+        index_.emplace(event.Addr, broadcasts_.size());
+        broadcasts_.push_back(Broadcast{event, 0});
+        return;
+    }
+
+    // Copies of the same change coming back mustn't restart its dissemination,
+    // the same suspicion confirmed by another member is news
+    auto& broadcast = broadcasts_[found->second];
+    bool confirmation = event.Info.Status == MemberInfo::State::Suspicious && event.Info == broadcast.Event.Info &&
+                        event.Info.Suspector != broadcast.Event.Info.Suspector;
+    if (confirmation || event.Info.Overrides(broadcast.Event.Info)) {
+        broadcast.Event = event;
+        broadcast.Transmits = 0;
+    }
+}
+
+void GossipPacker::Sync(const MemberTable& table) {
+    // Changes lost by the log are still spread by table samples
+    changes_.clear();
+    table.ChangesSince(tableVersion_, changes_);
+    Enqueue(changes_);
+}
+
+Gossip GossipPacker::Pack(uint16_t ttl, const Member& owner, const Member& dest, const MemberTable& table) {
+    Gossip gossip{};
+    Pack(gossip, ttl, owner, dest, table);
+    return gossip;
+}
+
+void GossipPacker::Pack(Gossip& gossip, uint16_t ttl, const Member& owner, const Member& dest,
+                        const MemberTable& table) {
+    gossip.TTL = ttl;
+    gossip.Owner = owner;
+    gossip.Dest = dest;
+
+    Fill(gossip, table);
+}
+
+void GossipPacker::Fill(Gossip& gossip, const MemberTable& table) {
+    // Failure detector messages are always v2
+    WireVersion version = gossip.Type == MessageKind::Gossip ? version_ : WireVersion::V2;
+
+    size_t size = gossip.ByteSize(version);
+    // Counts' varints grow with the number of records, so the widest is reserved
+    if (version == WireVersion::V2)
+        size += 2*(VarintSize(mtu_) - 1);
+
+    order_.resize(broadcasts_.size());
+    std::iota(order_.begin(), order_.end(), 0);
+    std::sort(order_.begin(), order_.end(), [this](size_t lhs, size_t rhs) {
+        const auto& left = broadcasts_[lhs];
+        const auto& right = broadcasts_[rhs];
+
+        if (left.Transmits != right.Transmits)
+            return left.Transmits < right.Transmits;
+
+        bool leftAlive = left.Event.Info.Status == MemberInfo::State::Alive;
+        bool rightAlive = right.Event.Info.Status == MemberInfo::State::Alive;
+        if (leftAlive != rightAlive)
+            return !leftAlive;
+
+        return left.Event.Info.Incarnation > right.Event.Info.Incarnation;
+    });
+
+    uint32_t prevIncarnation = 0;
+    for (size_t i : order_) {
+        uint32_t nextIncarnation = prevIncarnation;
+        size_t record = RecordSize(broadcasts_[i].Event, nextIncarnation, version);
+        // Shorter records further in the order may still fit
+        if (size + record > mtu_)
+            continue;
+
+        size += record;
+        prevIncarnation = nextIncarnation;
+
+        gossip.Events.push_back(broadcasts_[i].Event);
+        ++broadcasts_[i].Transmits;
+    }
+    Retire(RetransmitLimit(table.Size()));
+
+    if (!samples_ || size >= mtu_)
+        return;
+
+    sampled_.resize((mtu_ - size) / MinRecordSize(version));
+    sampled_.resize(table.Sample(sampled_.data(), sampled_.size()));
+    prevIncarnation = 0;
+    for (const auto& member : sampled_) {
+        uint32_t nextIncarnation = prevIncarnation;
+        size_t record = RecordSize(member, nextIncarnation, version);
+        if (size + record > mtu_)
+            continue;
+
+        size += record;
+        prevIncarnation = nextIncarnation;
+
+        gossip.Table.Insert(member);
+    }
+}
+
+size_t GossipPacker::Pending() const {
+    return broadcasts_.size();
+}
+
+size_t GossipPacker::MTU() const {
+    return mtu_;
+}
+
+WireVersion GossipPacker::Version() const {
+    return version_;
+}
+
+size_t GossipPacker::RetransmitLimit(size_t clusterSize) const {
+    auto scale = static_cast<size_t>(std::ceil(std::log10(static_cast<double>(clusterSize) + 1)));
+    return retransmitMult_*std::max<size_t>(scale, 1);
+}
+
+size_t GossipPacker::RecordSize(const Member& member, uint32_t& prevIncarnation, WireVersion version) {
+    if (version == WireVersion::V1)
+        return EncodedSize<Member>;
+
+    return MemberV2Size(member, prevIncarnation);
+}
+
+void GossipPacker::Retire(size_t limit) {
+    auto retired = std::remove_if(broadcasts_.begin(), broadcasts_.end(), [limit](const Broadcast& broadcast) {
+        return broadcast.Transmits >= limit;
+    });
+    if (retired == broadcasts_.end())
+        return;
+
+    broadcasts_.erase(retired, broadcasts_.end());
+
+    index_.clear();
+    for (size_t i = 0; i < broadcasts_.size(); ++i)
+        index_.emplace(broadcasts_[i].Event.Addr, i);
+}
@@ -0,0 +1,49 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <scheduler.hpp>
+
+ProtocolScheduler::ProtocolScheduler(boost::asio::io_service& ioService,
+                                     std::chrono::milliseconds period,
+                                     std::function<void()> round)
+  : ioService_{ioService}
+  , timer_{ioService}
+  , period_{period}
+  , round_{std::move(round)}
+  , notified_{false}
+  , rounds_{0}
+{}
+
+void ProtocolScheduler::Start() {
+    Arm();
+}
+
+void ProtocolScheduler::Notify() {
+    if (notified_.exchange(true))
+        return;
+
+    // Cancelled wait completes immediately and runs the round
+    ioService_.post([this] {
+        timer_.cancel();
+    });
+}
+
+std::size_t ProtocolScheduler::Rounds() const {
+    return rounds_;
+}
+
+void ProtocolScheduler::Arm() {
+    timer_.expires_from_now(period_);
+    timer_.async_wait([this](const boost::system::error_code&) {
+        Run();
+    });
+}
+
+void ProtocolScheduler::Run() {
+    // Gossips pushed during the round will post another wake-up
+    notified_.store(false);
+
+    round_();
+    ++rounds_;
+
+    Arm();
+}
@@ -0,0 +1,175 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <shared_writer.hpp>
+
+namespace {
+
+// Makes readers of a replaced view give up on it: its sequence stays
+// odd, so their `Read()` fails and they have to reopen the path
+void Retire(int fd) {
+    void* map = ::mmap(nullptr, sizeof(SharedViewHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return;
+
+    auto header = static_cast<SharedViewHeader*>(map);
+    if (header->Magic == SharedViewHeader::MagicValue) {
+        uint64_t sequence = header->Sequence.load(std::memory_order_relaxed);
+        header->Sequence.store(sequence | 1, std::memory_order_release);
+    }
+    ::munmap(map, sizeof(SharedViewHeader));
+}
+
+} // namespace
+
+SharedViewWriter::SharedViewWriter(const std::string& path, uint32_t capacity)
+  : map_{MAP_FAILED}
+  , size_{SharedViewSize(capacity)}
+  , published_{0}
+{
+    // Readers may have the previous file mapped, so it's never resized:
+    // a file of the same size is reused in place, any other is replaced
+    int previous = ::open(path.c_str(), O_RDWR);
+    if (previous >= 0) {
+        struct stat info{};
+        if (::fstat(previous, &info) == 0 && static_cast<std::size_t>(info.st_size) == size_)
+            map_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, previous, 0);
+        if (map_ != MAP_FAILED) {
+            ::close(previous);
+            previous = -1;
+        }
+    }
+
+    std::string created;
+    if (map_ == MAP_FAILED) {
+        created = path + ".new";
+        int fd = ::open(created.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        // Allocated up front, so a full disk fails here and not as
+        // SIGBUS on the first write through the mapping
+        if (fd >= 0 && ::posix_fallocate(fd, 0, static_cast<off_t>(size_)) == 0)
+            map_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    if (map_ == MAP_FAILED) {
+        if (previous >= 0)
+            ::close(previous);
+        if (!created.empty())
+            ::unlink(created.c_str());
+        throw std::runtime_error{"Unable to map shared view " + path};
+    }
+
+    SharedViewHeader* header = Header();
+
+    // Readers that mapped the file before a restart keep seeing a valid
+    // sequence, so it continues from where the previous run stopped
+    uint64_t sequence = 0;
+    if (header->Magic == SharedViewHeader::MagicValue)
+        sequence = (header->Sequence.load(std::memory_order_relaxed) + 1) & ~uint64_t{1};
+
+    header->Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header->Magic = SharedViewHeader::MagicValue;
+    header->LayoutVersion = SharedViewHeader::Layout;
+    header->RecordSize = sizeof(SharedMemberRecord);
+    header->Capacity = capacity;
+    header->Version.store(0, std::memory_order_relaxed);
+    header->Count.store(0, std::memory_order_relaxed);
+    header->Total.store(0, std::memory_order_relaxed);
+
+    header->Sequence.store(sequence + 2, std::memory_order_release);
+
+    // New readers get the complete view, the old ones are told to reopen
+    if (!created.empty()) {
+        if (::rename(created.c_str(), path.c_str()) != 0) {
+            ::munmap(map_, size_);
+            ::unlink(created.c_str());
+            if (previous >= 0)
+                ::close(previous);
+            throw std::runtime_error{"Unable to replace shared view " + path};
+        }
+        if (previous >= 0) {
+            Retire(previous);
+            ::close(previous);
+        }
+    }
+}
+
+SharedViewWriter::~SharedViewWriter() {
+    ::munmap(map_, size_);
+}
+
+bool SharedViewWriter::Publish(const MemberTable& table) {
+    // Version 0 is an empty table, which the view already shows
+    if (table.Version() == published_)
+        return false;
+
+    SharedViewHeader* header = Header();
+    SharedMemberRecord* records = Records();
+    uint32_t count = static_cast<uint32_t>(std::min<size_t>(table.Size(), header->Capacity));
+
+    uint64_t sequence = header->Sequence.load(std::memory_order_relaxed);
+    header->Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (uint32_t i = 0; i < count; ++i)
+        ToSharedRecord(table.set_[i], records[i]);
+    header->Count.store(count, std::memory_order_relaxed);
+    header->Total.store(static_cast<uint32_t>(table.Size()), std::memory_order_relaxed);
+    header->Version.store(table.Version(), std::memory_order_relaxed);
+
+    header->Sequence.store(sequence + 2, std::memory_order_release);
+
+    published_ = table.Version();
+    return true;
+}
+
+SharedViewHeader* SharedViewWriter::Header() {
+    return static_cast<SharedViewHeader*>(map_);
+}
+
+SharedMemberRecord* SharedViewWriter::Records() {
+    return reinterpret_cast<SharedMemberRecord*>(static_cast<char*>(map_) + sizeof(SharedViewHeader));
+}
+
+
+void ToSharedRecord(const Member& member, SharedMemberRecord& record) {
+    std::memset(record.Address, 0, sizeof(record.Address));
+    if (member.Addr.IP.is_v4()) {
+        auto bytes = member.Addr.IP.to_v4().to_bytes();
+        std::memcpy(record.Address, bytes.data(), bytes.size());
+        record.Family = 4;
+    } else {
+        auto bytes = member.Addr.IP.to_v6().to_bytes();
+        std::memcpy(record.Address, bytes.data(), bytes.size());
+        record.Family = 6;
+    }
+
+    record.Port = member.Addr.Port;
+    record.Status = static_cast<uint8_t>(member.Info.Status);
+    record.Incarnation = member.Info.Incarnation;
+    record.LastUpdate = member.Info.LastUpdate.Time;
+    record.Reserved = 0;
+}
+
+Member FromSharedRecord(const SharedMemberRecord& record) {
+    boost::asio::ip::address ip;
+    if (record.Family == 4) {
+        boost::asio::ip::address_v4::bytes_type bytes;
+        std::memcpy(bytes.data(), record.Address, bytes.size());
+        ip = boost::asio::ip::address_v4{bytes};
+    } else {
+        boost::asio::ip::address_v6::bytes_type bytes;
+        std::memcpy(bytes.data(), record.Address, bytes.size());
+        ip = boost::asio::ip::address_v6{bytes};
+    }
+
+    auto status = static_cast<MemberInfo::State>(record.Status & StateMask);
+    return Member{MemberAddr{ip, record.Port},
+                  MemberInfo{status, record.Incarnation, TimeStamp{record.LastUpdate}}};
+}
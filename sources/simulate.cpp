@@ -0,0 +1,15 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <iostream>
+
+#include <simulator.hpp>
+
+
+int main() {
+    SimulationConfig config = SimulationConfig::FromEnv();
+
+    Simulator simulator{config};
+    SimulationReport report = simulator.Run();
+
+    std::cout << report.ToJSON().dump(4) << std::endl;
+}
@@ -0,0 +1,330 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <stdexcept>
+#include <string>
+
+#include <config.hpp>
+#include <simulator.hpp>
+
+namespace {
+
+// Virtual nodes live in 10.0.0.0/8
+const uint32_t VirtualNetwork = 0x0A000000;
+const uint16_t VirtualPort = 8005;
+
+double Milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+SimulationConfig SimulationConfig::FromEnv() {
+    SimulationConfig config;
+
+    ReadEnv("GOSSIP_SIM_NODES", config.Nodes);
+    ReadEnv("GOSSIP_SIM_DURATION_MS", config.Duration);
+    ReadEnv("GOSSIP_SIM_PERIOD_MS", config.ProtocolPeriod, std::chrono::milliseconds{1});
+    ReadEnv("GOSSIP_SIM_LATENCY_MS", config.Latency);
+    ReadEnv("GOSSIP_SIM_JITTER_MS", config.Jitter);
+    ReadEnv("GOSSIP_SIM_LOSS", config.Loss);
+    ReadEnv("GOSSIP_SIM_SEED", config.Seed);
+
+    ReadEnv("GOSSIP_SIM_FANOUT", config.Fanout);
+    ReadEnv("GOSSIP_SIM_TTL", config.TTL);
+    ReadEnv("GOSSIP_SIM_MTU", config.GossipMTU);
+    ReadEnv("GOSSIP_SIM_RETRANSMIT_MULT", config.RetransmitMult);
+
+    unsigned version = static_cast<unsigned>(config.Version);
+    ReadEnv("GOSSIP_SIM_WIRE_VERSION", version);
+    if (version != static_cast<unsigned>(WireVersion::V1) && version != static_cast<unsigned>(WireVersion::V2)) {
+        throw std::invalid_argument{
+            "Unsupported GOSSIP_SIM_WIRE_VERSION: " + std::to_string(version)
+        };
+    }
+    config.Version = static_cast<WireVersion>(version);
+
+    ReadEnv("GOSSIP_SIM_DETECTION", config.Detection);
+    ReadEnv("GOSSIP_SIM_PROBE_INTERVAL_MS", config.Detector.ProbeInterval);
+    ReadEnv("GOSSIP_SIM_PROBE_TIMEOUT_MS", config.Detector.ProbeTimeout);
+    ReadEnv("GOSSIP_SIM_INDIRECT_CHECKS", config.Detector.IndirectChecks);
+    ReadEnv("GOSSIP_SIM_SUSPICION_MULT", config.Detector.SuspicionMult);
+    ReadEnv("GOSSIP_SIM_SUSPICION_MAX_MULT", config.Detector.SuspicionMaxMult);
+    ReadEnv("GOSSIP_SIM_MAX_HEALTH_SCORE", config.Detector.MaxHealthScore);
+
+    ReadEnv("GOSSIP_SIM_CRASHES", config.Crashes);
+    ReadEnv("GOSSIP_SIM_CRASH_AT_MS", config.CrashAt);
+    ReadEnv("GOSSIP_SIM_PARTITION_SIZE", config.PartitionSize);
+    ReadEnv("GOSSIP_SIM_PARTITION_FROM_MS", config.PartitionFrom);
+    ReadEnv("GOSSIP_SIM_PARTITION_TO_MS", config.PartitionTo);
+
+    return config;
+}
+
+
+nlohmann::json SimulationReport::ToJSON() const {
+    auto json = nlohmann::json::object();
+
+    json["join_convergence_ms"] = JoinConvergenceMs;
+    json["failure_convergence_ms"] = FailureConvergenceMs;
+    json["bytes_per_node_per_second"] = BytesPerNodePerSecond;
+    json["datagrams"] = Datagrams;
+    json["lost"] = Lost;
+    json["coalesced"] = Coalesced;
+    json["false_suspicions"] = FalseSuspicions;
+    json["false_deaths"] = FalseDeaths;
+    json["false_positive_rate"] = FalsePositiveRate;
+
+    return json;
+}
+
+
+Simulator::Node::Node(const SimulationConfig& config, const Member& self, uint32_t seed)
+  : Self{self}
+  , Table{seed}
+  , Packer{config.GossipMTU, config.Version, config.RetransmitMult}
+  , Detector{self.Addr, config.Detector, Packer}
+  , Inbox{}
+  , TableVersion{0}
+  , Changes{}
+{}
+
+bool Simulator::Event::operator>(const Event& rhs) const {
+    if (At != rhs.At)
+        return At > rhs.At;
+
+    return Order > rhs.Order;
+}
+
+Simulator::Simulator(const SimulationConfig& config)
+  : config_{config}
+  , generator_{config.Seed}
+  , nodes_{}
+  , events_{}
+  , order_{0}
+  , merge_{}
+  , gossips_{}
+  , targets_{}
+  , payloads_{}
+  , freePayloads_{}
+  , report_{}
+  , bytes_{0}
+{
+    if (config_.Nodes == 0 || config_.Crashes >= config_.Nodes) {
+        throw std::invalid_argument{
+            "Simulation needs at least one node that never crashes"
+        };
+    }
+    // Round offsets are drawn from [0, ProtocolPeriod) and a zero period
+    // would never let virtual time move
+    if (config_.ProtocolPeriod <= std::chrono::milliseconds::zero()) {
+        throw std::invalid_argument{
+            "Simulation needs a positive protocol period"
+        };
+    }
+    if (!(config_.Loss >= 0.0 && config_.Loss <= 1.0)) {
+        throw std::invalid_argument{
+            "Simulation loss must be in [0, 1]"
+        };
+    }
+    if (config_.Detection && config_.Version != WireVersion::V2) {
+        throw std::invalid_argument{
+            "Failure detection needs wire format v2"
+        };
+    }
+
+    Member introducer{Address(0), MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}};
+
+    nodes_.reserve(config_.Nodes);
+    for (std::size_t i = 0; i < config_.Nodes; ++i) {
+        Member self{Address(i), MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}};
+        nodes_.emplace_back(new Node{config_, self, static_cast<uint32_t>(generator_())});
+
+        // Everybody joins through the first node
+        nodes_.back()->Table.UpdateRecordIfNewer(self);
+        nodes_.back()->Table.UpdateRecordIfNewer(introducer);
+    }
+}
+
+SimulationReport Simulator::Run() {
+    // Rounds of different nodes aren't aligned in real life either
+    std::uniform_int_distribution<Clock::rep> offset{0, Clock::duration{config_.ProtocolPeriod}.count() - 1};
+    for (std::size_t i = 0; i < nodes_.size(); ++i)
+        Schedule(Time{} + Clock::duration{offset(generator_)}, EventKind::Round, i);
+    Schedule(Since(config_.ProtocolPeriod), EventKind::Check, 0);
+
+    Time end = Since(config_.Duration);
+    while (!events_.empty() && events_.top().At <= end) {
+        Event event = events_.top();
+        events_.pop();
+
+        switch (event.Kind) {
+        case EventKind::Round:
+            Round(event.Node, event.At);
+            break;
+        case EventKind::Deliver:
+            Deliver(event.Node, event.Payload, event.At);
+            break;
+        case EventKind::Check:
+            Check(event.At);
+            break;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(config_.Duration).count();
+    if (seconds > 0)
+        report_.BytesPerNodePerSecond = static_cast<double>(bytes_) / nodes_.size() / seconds;
+
+    double live = static_cast<double>(config_.Nodes - config_.Crashes);
+    if (live > 1)
+        report_.FalsePositiveRate = static_cast<double>(report_.FalseDeaths) / (live * (live - 1));
+
+    return report_;
+}
+
+MemberAddr Simulator::Address(std::size_t i) {
+    return MemberAddr{boost::asio::ip::address_v4{VirtualNetwork + static_cast<uint32_t>(i)}, VirtualPort};
+}
+
+void Simulator::Schedule(Time at, EventKind kind, std::size_t node, std::size_t payload) {
+    events_.push(Event{at, order_++, kind, node, payload});
+}
+
+void Simulator::Round(std::size_t node, Time now) {
+    // Crashed node just stops, so nobody schedules its rounds anymore
+    if (CrashedAt(node, now))
+        return;
+
+    Node& current = *nodes_[node];
+    std::deque<Conflict> conflicts;
+    report_.Coalesced += UpdateTable(current.Table, current.Inbox, merge_, conflicts);
+
+    std::deque<Gossip> probes;
+    if (config_.Detection) {
+        for (const auto& packet : current.Inbox)
+            current.Detector.Handle(packet.View, current.Table, now, probes);
+        current.Detector.Tick(current.Table, now, probes);
+    }
+
+    gossips_.Clear();
+    GenerateGossips(current.Table, current.Packer, current.Inbox, gossips_);
+    current.Inbox.clear();
+
+    // Distinct random targets, the probe order belongs to the detector
+    const Member& self = config_.Detection ? current.Detector.Self() : current.Self;
+    targets_.resize(config_.Fanout + 1);
+    std::size_t sampled = current.Table.Sample(targets_.data(), targets_.size(), MemberTable::LiveStatus);
+    for (std::size_t i = 0, sent = 0; i < sampled && sent < config_.Fanout; ++i) {
+        if (targets_[i].Addr == self.Addr)
+            continue;
+
+        current.Packer.Pack(gossips_.Next(), config_.TTL, self, targets_[i], current.Table);
+        ++sent;
+    }
+
+    Send(node, probes, now);
+    Send(node, gossips_, now);
+
+    Schedule(now + config_.ProtocolPeriod, EventKind::Round, node);
+}
+
+template < typename Gossips >
+void Simulator::Send(std::size_t from, const Gossips& gossips, Time now) {
+    std::uniform_real_distribution<double> loss{0.0, 1.0};
+    std::uniform_int_distribution<Clock::rep> jitter{0, Clock::duration{config_.Jitter}.count()};
+
+    for (const auto& gossip : gossips) {
+        std::size_t payload = 0;
+        if (freePayloads_.empty()) {
+            payload = payloads_.size();
+            payloads_.emplace_back();
+        } else {
+            payload = freePayloads_.back();
+            freePayloads_.pop_back();
+        }
+
+        auto& bytes = payloads_[payload];
+        bytes = ByteBuffer{gossip.ByteSize(config_.Version)};
+        byte* end = gossip.Write(bytes.Begin(), bytes.End(), config_.Version);
+        bytes.Shrink(end ? end - bytes.Begin() : 0);
+
+        bytes_ += bytes.Size();
+        ++report_.Datagrams;
+
+        std::size_t to = gossip.Dest.Addr.IP.to_v4().to_uint() - VirtualNetwork;
+        if (to >= nodes_.size() || !Reachable(from, to, now) || loss(generator_) < config_.Loss) {
+            ++report_.Lost;
+            freePayloads_.push_back(payload);
+            continue;
+        }
+
+        Schedule(now + config_.Latency + Clock::duration{jitter(generator_)}, EventKind::Deliver, to, payload);
+    }
+}
+
+void Simulator::Deliver(std::size_t node, std::size_t payload, Time now) {
+    Packet packet{};
+    packet.Bytes = std::move(payloads_[payload]);
+    freePayloads_.push_back(payload);
+
+    if (CrashedAt(node, now) || !packet.View.Parse(packet.Bytes.Begin(), packet.Bytes.End())) {
+        ++report_.Lost;
+        return;
+    }
+
+    nodes_[node]->Inbox.push_back(std::move(packet));
+}
+
+void Simulator::Check(Time now) {
+    std::size_t live = config_.Nodes - config_.Crashes;
+    bool crashed = config_.Crashes != 0 && now >= Since(config_.CrashAt);
+
+    bool joined = true;
+    bool detected = crashed;
+    for (std::size_t i = 0; i < live; ++i) {
+        Node& node = *nodes_[i];
+
+        joined = joined && node.Table.Size() == nodes_.size();
+
+        for (std::size_t c = live; detected && c < nodes_.size(); ++c) {
+            const Member* record = node.Table.Find(Address(c));
+            detected = record && (record->Info.Status == MemberInfo::State::Dead ||
+                                  record->Info.Status == MemberInfo::State::Left);
+        }
+
+        // Changes lost by the log are just not counted
+        node.Changes.clear();
+        node.Table.ChangesSince(node.TableVersion, node.Changes);
+        for (const auto& change : node.Changes) {
+            std::size_t member = change.Addr.IP.to_v4().to_uint() - VirtualNetwork;
+            if (member >= live && crashed)
+                continue;
+
+            if (change.Info.Status == MemberInfo::State::Suspicious)
+                ++report_.FalseSuspicions;
+            else if (change.Info.Status == MemberInfo::State::Dead)
+                ++report_.FalseDeaths;
+        }
+    }
+
+    if (joined && report_.JoinConvergenceMs < 0)
+        report_.JoinConvergenceMs = Milliseconds(now - Time{});
+    if (detected && report_.FailureConvergenceMs < 0)
+        report_.FailureConvergenceMs = Milliseconds(now - Since(config_.CrashAt));
+
+    Schedule(now + config_.ProtocolPeriod, EventKind::Check, 0);
+}
+
+bool Simulator::Reachable(std::size_t from, std::size_t to, Time now) const {
+    if (now < Since(config_.PartitionFrom) || now >= Since(config_.PartitionTo))
+        return true;
+
+    return (from < config_.PartitionSize) == (to < config_.PartitionSize);
+}
+
+bool Simulator::CrashedAt(std::size_t node, Time now) const {
+    return node >= config_.Nodes - config_.Crashes && now >= Since(config_.CrashAt);
+}
+
+Simulator::Time Simulator::Since(std::chrono::milliseconds offset) const {
+    return Time{} + offset;
+}
@@ -0,0 +1,213 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <member_index.hpp>
+#include <shared_writer.hpp>
+#include <snapshot.hpp>
+
+namespace {
+
+size_t FileSize(uint32_t capacity) {
+    return sizeof(TableSnapshot::FileHeader) + 2 * sizeof(TableSnapshot::SlotHeader) +
+           2 * sizeof(SharedMemberRecord) * capacity;
+}
+
+} // namespace
+
+TableSnapshot::TableSnapshot(const std::string& path, uint32_t capacity)
+  : path_{path}
+  , map_{MAP_FAILED}
+  , size_{0}
+  , capacity_{0}
+  , generation_{0}
+  , savedVersion_{0}
+  , savedIncarnation_{0}
+  , saved_{false}
+  , replacing_{false}
+{
+    // An existing snapshot keeps its capacity until it has to grow
+    struct stat info{};
+    if (::stat(path.c_str(), &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(FileHeader)) {
+        Map(path_, 0);
+        if (Valid()) {
+            int latest = Latest();
+            if (latest >= 0)
+                generation_ = Slot(latest)->Generation;
+            return;
+        }
+    }
+
+    Map(path_, std::max<uint32_t>(capacity, 1));
+}
+
+TableSnapshot::~TableSnapshot() {
+    Unmap();
+}
+
+bool TableSnapshot::Load(MemberTable& table, uint32_t& incarnation) const {
+    if (!Valid())
+        return false;
+
+    int latest = Latest();
+    if (latest < 0)
+        return false;
+
+    const SlotHeader* slot = Slot(latest);
+    const SharedMemberRecord* records = Records(latest);
+    for (uint32_t i = 0; i < slot->Count; ++i)
+        table.UpdateRecordIfNewer(FromSharedRecord(records[i]));
+    incarnation = slot->Incarnation;
+
+    return true;
+}
+
+bool TableSnapshot::Save(const MemberTable& table, uint32_t incarnation) {
+    if (saved_ && table.Version() == savedVersion_ && incarnation == savedIncarnation_)
+        return false;
+
+    // A grown file is written aside and replaces the current one only
+    // when it holds this snapshot, so a crash meanwhile loses nothing.
+    // The current mapping stays until the grown one is ready
+    std::string grown = path_ + ".grow";
+    if (table.Size() > capacity_ || !Valid()) {
+        Map(grown, std::max<uint32_t>(static_cast<uint32_t>(table.Size()), 2 * capacity_));
+        replacing_ = true;
+    }
+
+    int latest = Latest();
+    int slot = latest == 0 ? 1 : 0;
+
+    SharedMemberRecord* records = Records(slot);
+    for (size_t i = 0; i < table.Size(); ++i)
+        ToSharedRecord(table.set_[i], records[i]);
+
+    SlotHeader* header = Slot(slot);
+    // Invalid until the checksum is written
+    header->Generation = 0;
+    header->Count = static_cast<uint32_t>(table.Size());
+    header->Incarnation = incarnation;
+    header->Generation = ++generation_;
+    header->Checksum = Checksum(slot);
+
+    // Until the rename succeeds saves keep going to the grown file
+    if (replacing_) {
+        if (::msync(map_, size_, MS_SYNC) != 0 || std::rename(grown.c_str(), path_.c_str()) != 0)
+            throw std::runtime_error{"Unable to replace snapshot " + path_};
+        replacing_ = false;
+    } else {
+        ::msync(map_, size_, MS_ASYNC);
+    }
+
+    savedVersion_ = table.Version();
+    savedIncarnation_ = incarnation;
+    saved_ = true;
+
+    return true;
+}
+
+uint64_t TableSnapshot::Generation() const {
+    return generation_;
+}
+
+void TableSnapshot::Map(const std::string& path, uint32_t capacity) {
+    // Zero capacity maps the file as it is
+    bool fresh = capacity != 0;
+    int fd = ::open(path.c_str(), fresh ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0)
+        throw std::runtime_error{"Unable to open snapshot " + path};
+
+    size_t size = 0;
+    if (fresh) {
+        size = FileSize(capacity);
+    } else {
+        struct stat info{};
+        ::fstat(fd, &info);
+        size = static_cast<size_t>(info.st_size);
+    }
+
+    // Blocks are allocated up front, so a full disk fails here and
+    // not as SIGBUS on a write through the mapping
+    void* map = MAP_FAILED;
+    if (size != 0 && ::posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0)
+        map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+        throw std::runtime_error{"Unable to map snapshot " + path};
+
+    Unmap();
+    map_ = map;
+    size_ = size;
+
+    if (!fresh) {
+        capacity_ = Valid() ? Header()->Capacity : 0;
+        return;
+    }
+
+    std::memset(map_, 0, sizeof(FileHeader) + 2 * sizeof(SlotHeader));
+    FileHeader* header = Header();
+    header->Magic = FileHeader::MagicValue;
+    header->LayoutVersion = FileHeader::Layout;
+    header->RecordSize = sizeof(SharedMemberRecord);
+    header->Capacity = capacity;
+    capacity_ = capacity;
+}
+
+void TableSnapshot::Unmap() {
+    if (map_ != MAP_FAILED)
+        ::munmap(map_, size_);
+    map_ = MAP_FAILED;
+    size_ = 0;
+}
+
+int TableSnapshot::Latest() const {
+    int latest = -1;
+    for (int slot = 0; slot < 2; ++slot) {
+        const SlotHeader* header = Slot(slot);
+        if (header->Generation == 0 || header->Count > capacity_ || header->Checksum != Checksum(slot))
+            continue;
+        if (latest < 0 || header->Generation > Slot(latest)->Generation)
+            latest = slot;
+    }
+
+    return latest;
+}
+
+bool TableSnapshot::Valid() const {
+    const FileHeader* header = Header();
+    return header->Magic == FileHeader::MagicValue &&
+           header->LayoutVersion == FileHeader::Layout &&
+           header->RecordSize == sizeof(SharedMemberRecord) &&
+           FileSize(header->Capacity) <= size_;
+}
+
+TableSnapshot::FileHeader* TableSnapshot::Header() const {
+    return static_cast<FileHeader*>(map_);
+}
+
+TableSnapshot::SlotHeader* TableSnapshot::Slot(int slot) const {
+    return reinterpret_cast<SlotHeader*>(static_cast<char*>(map_) + sizeof(FileHeader)) + slot;
+}
+
+SharedMemberRecord* TableSnapshot::Records(int slot) const {
+    char* records = static_cast<char*>(map_) + sizeof(FileHeader) + 2 * sizeof(SlotHeader);
+    return reinterpret_cast<SharedMemberRecord*>(records) + static_cast<size_t>(slot) * capacity_;
+}
+
+uint64_t TableSnapshot::Checksum(int slot) const {
+    const SlotHeader* header = Slot(slot);
+    uint64_t checksum = MemberIndex::Mix(header->Generation);
+    checksum = MemberIndex::Mix(checksum ^ ((static_cast<uint64_t>(header->Count) << 32) | header->Incarnation));
+
+    // Records are 32 B, so they are read as whole words
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(Records(slot));
+    size_t count = std::min(header->Count, capacity_) * sizeof(SharedMemberRecord) / sizeof(uint64_t);
+    for (size_t i = 0; i < count; ++i)
+        checksum = MemberIndex::Mix(checksum ^ words[i]);
+
+    return checksum;
+}
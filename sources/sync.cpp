@@ -0,0 +1,546 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <sync.hpp>
+
+namespace {
+
+// Members sampled to find a peer other than self
+const size_t PeerCandidates = 4;
+// Digest level is picked to give about that many records per range
+const size_t RecordsPerRange = 8;
+// Failed accepts (e.g. out of descriptors) are retried after a pause
+const std::chrono::milliseconds AcceptRetryDelay{100};
+
+void StartFrame(std::vector<byte>& out, uint8_t kind) {
+    out.assign(sizeof(uint32_t), 0);
+    out.push_back(kind);
+}
+
+// Size of the frame goes to its first bytes
+void EndFrame(std::vector<byte>& out) {
+    uint32_t size = htonl(static_cast<uint32_t>(out.size() - sizeof(uint32_t)));
+    std::memcpy(out.data(), &size, sizeof(size));
+}
+
+template < typename Record >
+void PutRecord(std::vector<byte>& out, const Record& value) {
+    size_t offset = out.size();
+    out.resize(offset + value.ByteSize());
+    value.Write(out.data() + offset, out.data() + out.size());
+}
+
+template < typename Type >
+void PutNumber(std::vector<byte>& out, Type number) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(Type));
+    WriteNumberToBytes(out.data() + offset, out.data() + out.size(), number);
+}
+
+} // namespace
+
+PushPullSync::Session::Session(boost::asio::io_service& ioService, bool outbound, bool digest)
+  : Socket{ioService}
+  , Deadline{ioService}
+  , Header{}
+  , Local{}
+  , Remote{}
+  , Outbound{outbound}
+  , Digest{digest}
+  , Done{false}
+{}
+
+PushPullSync::PushPullSync(boost::asio::io_service& ioService, MemberTable& table, const MemberAddr& self,
+                           const SyncConfig& config)
+  : ioService_{ioService}
+  , table_{table}
+  , self_{self}
+  , config_{config}
+  , acceptor_{ioService}
+  , timer_{ioService}
+  , acceptRetry_{ioService}
+  , seeds_{}
+  , outbound_{false}
+  , inbound_{0}
+  , started_{0}
+  , completed_{0}
+  , failed_{0}
+  , matched_{0}
+  , bytesSent_{0}
+  , conflicts_{nullptr}
+{
+    using boost::asio::ip::tcp;
+
+    // Options must be set between `open()` and `bind()`
+    acceptor_.open(tcp::v4());
+    acceptor_.set_option(tcp::acceptor::reuse_address{true});
+    acceptor_.bind(tcp::endpoint{boost::asio::ip::address_v4::any(), self.Port});
+    acceptor_.listen();
+}
+
+void PushPullSync::Start() {
+    Accept();
+    Arm();
+}
+
+void PushPullSync::Join(const std::vector<MemberAddr>& seeds) {
+    seeds_.clear();
+    for (const auto& seed : seeds) {
+        if (!(seed == self_))
+            seeds_.push_back(seed);
+    }
+
+    if (seeds_.empty() || outbound_)
+        return;
+
+    outbound_ = true;
+    Dial(std::make_shared<std::vector<MemberAddr>>(seeds_), 0, false);
+}
+
+bool PushPullSync::Exchange(const MemberAddr& peer) {
+    if (outbound_)
+        return false;
+
+    outbound_ = true;
+    Dial(std::make_shared<std::vector<MemberAddr>>(1, peer), 0, config_.Digests);
+    return true;
+}
+
+void PushPullSync::CountConflicts(MetricsRegistry::Counter& counter) {
+    conflicts_ = &counter;
+}
+
+size_t PushPullSync::Completed() const {
+    return completed_;
+}
+
+size_t PushPullSync::Failed() const {
+    return failed_;
+}
+
+size_t PushPullSync::Matched() const {
+    return matched_;
+}
+
+size_t PushPullSync::BytesSent() const {
+    return bytesSent_;
+}
+
+std::chrono::milliseconds PushPullSync::Interval() const {
+    const double baseSize = 32;
+
+    size_t scale = 1;
+    if (table_.Size() > baseSize)
+        scale += static_cast<size_t>(std::ceil(std::log2(table_.Size() / baseSize)));
+
+    return config_.Interval * scale;
+}
+
+void PushPullSync::Accept() {
+    auto session = std::make_shared<Session>(ioService_, false, false);
+
+    acceptor_.async_accept(session->Socket, [this, session](const boost::system::error_code& error) {
+        if (error == boost::asio::error::operation_aborted)
+            return;
+        if (error) {
+            std::cout << "Unable to accept push-pull peer: " << error.message() << std::endl;
+            acceptRetry_.expires_after(AcceptRetryDelay);
+            acceptRetry_.async_wait([this](const boost::system::error_code& error) {
+                if (!error)
+                    Accept();
+            });
+            return;
+        }
+
+        if (inbound_ < config_.MaxInbound) {
+            ++inbound_;
+            Watch(session);
+            Serve(session);
+        } else {
+            boost::system::error_code closeError;
+            session->Socket.close(closeError);
+        }
+
+        Accept();
+    });
+}
+
+void PushPullSync::Serve(const SessionPtr& session) {
+    ReadFrame(session, [this, session](Frame kind, const byte* begin, const byte* end) {
+        if (kind == Frame::State) {
+            // The initiator gets our state as it was before its one
+            StateFrame(session->Local);
+            bool merged = Merge(begin, end);
+            WriteFrame(session, [this, session, merged] {
+                Finish(session, merged);
+            });
+            return;
+        }
+
+        uint8_t level = 0;
+        uint64_t root = 0;
+        if (kind != Frame::Digest ||
+            !(begin = ReadNumberFromBytes(begin, end, level)) ||
+            ReadNumberFromBytes(begin, end, root) != end ||
+            level > MemberTable::DigestDepth) {
+            Finish(session, false);
+            return;
+        }
+
+        if (root == table_.Digest()) {
+            StartFrame(session->Local, static_cast<uint8_t>(Frame::InSync));
+            EndFrame(session->Local);
+            WriteFrame(session, [this, session] {
+                ++matched_;
+                Finish(session, true);
+            });
+            return;
+        }
+
+        std::vector<uint64_t> digests;
+        table_.RangeDigests(level, digests);
+        StartFrame(session->Local, static_cast<uint8_t>(Frame::Ranges));
+        PutNumber(session->Local, level);
+        for (auto digest : digests)
+            PutNumber(session->Local, digest);
+        EndFrame(session->Local);
+
+        WriteFrame(session, [this, session] {
+            ReadFrame(session, [this, session](Frame kind, const byte* begin, const byte* end) {
+                if (kind != Frame::Repair) {
+                    Finish(session, false);
+                    return;
+                }
+                Repair(session, begin, end);
+            });
+        });
+    });
+}
+
+void PushPullSync::Repair(const SessionPtr& session, const byte* begin, const byte* end) {
+    uint8_t level = 0;
+    if (!(begin = ReadNumberFromBytes(begin, end, level)) || level > MemberTable::DigestDepth) {
+        Finish(session, false);
+        return;
+    }
+
+    size_t rangesCount = size_t{1} << level;
+    if (static_cast<size_t>(end - begin) < (rangesCount + 7) / 8) {
+        Finish(session, false);
+        return;
+    }
+
+    std::vector<bool> ranges(rangesCount);
+    for (size_t i = 0; i < rangesCount; ++i)
+        ranges[i] = (begin[i / 8] >> (i % 8)) & 1;
+    begin += (rangesCount + 7) / 8;
+
+    // The initiator gets our records as they were before its ones
+    RecordsFrame(session->Local, Frame::Records, level, ranges);
+    bool merged = Merge(begin, end);
+    WriteFrame(session, [this, session, merged] {
+        Finish(session, merged);
+    });
+}
+
+void PushPullSync::Dial(std::shared_ptr<std::vector<MemberAddr>> peers, size_t i, bool digest) {
+    auto session = std::make_shared<Session>(ioService_, true, digest);
+    Watch(session);
+
+    const MemberAddr& peer = (*peers)[i];
+    boost::asio::ip::tcp::endpoint endpoint{peer.IP, peer.Port};
+
+    session->Socket.async_connect(endpoint, [this, session, peers, i, digest](const boost::system::error_code& error) {
+        if (error) {
+            if (i + 1 < peers->size() && !session->Done) {
+                // Quietly, the exchange isn't over yet
+                session->Done = true;
+                session->Deadline.cancel();
+                Dial(peers, i + 1, digest);
+            } else {
+                Finish(session, false);
+            }
+            return;
+        }
+
+        Initiate(session);
+    });
+}
+
+void PushPullSync::Initiate(const SessionPtr& session) {
+    if (!session->Digest) {
+        StateFrame(session->Local);
+        WriteFrame(session, [this, session] {
+            ReadFrame(session, [this, session](Frame kind, const byte* begin, const byte* end) {
+                Finish(session, kind == Frame::State && Merge(begin, end));
+            });
+        });
+        return;
+    }
+
+    StartFrame(session->Local, static_cast<uint8_t>(Frame::Digest));
+    PutNumber(session->Local, static_cast<uint8_t>(DigestLevel()));
+    PutNumber(session->Local, table_.Digest());
+    EndFrame(session->Local);
+
+    WriteFrame(session, [this, session] {
+        ReadFrame(session, [this, session](Frame kind, const byte* begin, const byte* end) {
+            if (kind == Frame::InSync) {
+                ++matched_;
+                Finish(session, true);
+            } else if (kind == Frame::Ranges) {
+                Compare(session, begin, end);
+            } else {
+                Finish(session, false);
+            }
+        });
+    });
+}
+
+void PushPullSync::Compare(const SessionPtr& session, const byte* begin, const byte* end) {
+    uint8_t level = 0;
+    if (!(begin = ReadNumberFromBytes(begin, end, level)) || level > MemberTable::DigestDepth ||
+        static_cast<size_t>(end - begin) != sizeof(uint64_t) << level) {
+        Finish(session, false);
+        return;
+    }
+
+    std::vector<uint64_t> digests;
+    table_.RangeDigests(level, digests);
+
+    std::vector<bool> ranges(digests.size());
+    for (size_t i = 0; i < digests.size(); ++i) {
+        uint64_t remote = 0;
+        begin = ReadNumberFromBytes(begin, end, remote);
+        ranges[i] = remote != digests[i];
+    }
+
+    RecordsFrame(session->Local, Frame::Repair, level, ranges);
+    WriteFrame(session, [this, session] {
+        ReadFrame(session, [this, session](Frame kind, const byte* begin, const byte* end) {
+            Finish(session, kind == Frame::Records && Merge(begin, end));
+        });
+    });
+}
+
+void PushPullSync::Arm() {
+    if (config_.Interval.count() == 0)
+        return;
+
+    timer_.expires_after(Interval());
+    timer_.async_wait([this](const boost::system::error_code& error) {
+        if (error)
+            return;
+
+        MemberAddr peer{};
+        if (!outbound_ && PickPeer(peer))
+            Exchange(peer);
+
+        Arm();
+    });
+}
+
+bool PushPullSync::PickPeer(MemberAddr& peer) {
+    ++started_;
+
+    std::vector<MemberTable::StatusFilter> filters;
+    if (config_.ReconnectEvery != 0 && started_ % config_.ReconnectEvery == 0)
+        filters.push_back(MemberTable::OnlyStatus(MemberInfo::State::Dead));
+    filters.push_back(MemberTable::OnlyStatus(MemberInfo::State::Alive));
+
+    Member candidates[PeerCandidates];
+    for (auto filter : filters) {
+        size_t count = table_.Sample(candidates, PeerCandidates, filter);
+        for (size_t i = 0; i < count; ++i) {
+            if (!(candidates[i].Addr == self_)) {
+                peer = candidates[i].Addr;
+                return true;
+            }
+        }
+    }
+
+    // Nobody else is alive, maybe we are the one cut off
+    if (seeds_.empty())
+        return false;
+
+    peer = seeds_[started_ % seeds_.size()];
+    return true;
+}
+
+template < typename Handler >
+void PushPullSync::ReadFrame(const SessionPtr& session, Handler handler) {
+    boost::asio::async_read(session->Socket, boost::asio::buffer(session->Header),
+                            [this, session, handler](const boost::system::error_code& error, size_t) {
+        uint32_t size = 0;
+        std::memcpy(&size, session->Header.data(), sizeof(size));
+        size = ntohl(size);
+
+        if (error || size == 0 || size > config_.MaxStateSize) {
+            Finish(session, false);
+            return;
+        }
+
+        session->Remote.resize(size);
+        boost::asio::async_read(session->Socket, boost::asio::buffer(session->Remote),
+                                [this, session, handler](const boost::system::error_code& error, size_t) {
+            if (error) {
+                Finish(session, false);
+                return;
+            }
+
+            const byte* begin = session->Remote.data();
+            handler(static_cast<Frame>(*begin), begin + 1, begin + session->Remote.size());
+        });
+    });
+}
+
+template < typename Handler >
+void PushPullSync::WriteFrame(const SessionPtr& session, Handler handler) {
+    bytesSent_ += session->Local.size();
+    boost::asio::async_write(session->Socket, boost::asio::buffer(session->Local),
+                             [this, session, handler](const boost::system::error_code& error, size_t) {
+        if (error) {
+            Finish(session, false);
+            return;
+        }
+
+        handler();
+    });
+}
+
+void PushPullSync::StateFrame(std::vector<byte>& out) const {
+    StartFrame(out, static_cast<uint8_t>(Frame::State));
+    PutRecord(out, Owner());
+    PutRecord(out, table_);
+    EndFrame(out);
+}
+
+void PushPullSync::RecordsFrame(std::vector<byte>& out, Frame kind, size_t level,
+                                const std::vector<bool>& ranges) const {
+    StartFrame(out, static_cast<uint8_t>(kind));
+    if (kind == Frame::Repair) {
+        PutNumber(out, static_cast<uint8_t>(level));
+
+        size_t flags = out.size();
+        out.resize(flags + (ranges.size() + 7) / 8, 0);
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (ranges[i])
+                out[flags + i / 8] |= static_cast<byte>(1u << (i % 8));
+        }
+    }
+
+    PutRecord(out, Owner());
+
+    // Same encoding as `MemberTable`
+    std::vector<Member> records;
+    table_.RangeRecords(level, ranges, records);
+    PutNumber(out, records.size());
+    size_t offset = out.size();
+    out.resize(offset + records.size()*EncodedSize<Member>);
+    WriteRecords(out.data() + offset, out.data() + out.size(), records.begin(), records.size());
+
+    EndFrame(out);
+}
+
+Member PushPullSync::Owner() const {
+    if (const Member* record = table_.Find(self_))
+        return *record;
+
+    return Member{self_, MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}};
+}
+
+size_t PushPullSync::DigestLevel() const {
+    size_t level = 0;
+    while (level < MemberTable::DigestDepth && (RecordsPerRange << level) < table_.Size())
+        ++level;
+
+    return level;
+}
+
+bool PushPullSync::Merge(const byte* begin, const byte* end) {
+    Gossip gossip{};
+    if (!(begin = gossip.Owner.Read(begin, end)))
+        return false;
+    if (gossip.Table.Read(begin, end) != end)
+        return false;
+
+    // Conflicts are only counted, as for gossips
+    std::deque<Conflict> conflicts;
+    table_.Update(gossip, conflicts);
+    if (conflicts_)
+        conflicts_->Add(conflicts.size());
+
+    return true;
+}
+
+void PushPullSync::Watch(const SessionPtr& session) {
+    session->Deadline.expires_after(config_.Timeout);
+    session->Deadline.async_wait([session](const boost::system::error_code& error) {
+        // Pending operations complete with `operation_aborted`
+        if (!error) {
+            boost::system::error_code closeError;
+            session->Socket.close(closeError);
+        }
+    });
+}
+
+void PushPullSync::Finish(const SessionPtr& session, bool ok) {
+    if (session->Done)
+        return;
+    session->Done = true;
+
+    session->Deadline.cancel();
+    boost::system::error_code error;
+    session->Socket.close(error);
+
+    if (session->Outbound)
+        outbound_ = false;
+    else
+        --inbound_;
+
+    if (ok)
+        ++completed_;
+    else
+        ++failed_;
+}
+
+
+std::vector<MemberAddr> ParseSeeds(const std::string& seeds) {
+    std::vector<MemberAddr> result;
+
+    size_t begin = 0;
+    while (begin < seeds.size()) {
+        size_t end = seeds.find(',', begin);
+        if (end == std::string::npos)
+            end = seeds.size();
+
+        std::string seed = seeds.substr(begin, end - begin);
+        size_t colon = seed.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == seed.size())
+            throw std::invalid_argument{"Invalid seed: " + seed};
+
+        boost::system::error_code error;
+        auto ip = boost::asio::ip::address::from_string(seed.substr(0, colon), error);
+        char* portEnd = nullptr;
+        unsigned long port = std::strtoul(seed.c_str() + colon + 1, &portEnd, 10);
+        if (error || *portEnd != '\0' || port == 0 || port > 65535)
+            throw std::invalid_argument{"Invalid seed: " + seed};
+
+        result.emplace_back(ip, static_cast<uint16_t>(port));
+        begin = end + 1;
+    }
+
+    return result;
+}
@@ -1,6 +1,7 @@
 // Copyright 2019 AndreevSemen semen.andreev00@mail.ru
 
 #include <types.hpp>
+#include <json_writer.hpp>
 #include <deque>
 
 MemberAddr::MemberAddr(boost::asio::ip::address addr, uint16_t port)
@@ -9,34 +10,23 @@ MemberAddr::MemberAddr(boost::asio::ip::address addr, uint16_t port)
 {}
 
 size_t MemberAddr::Hasher::operator()(const MemberAddr& key) const {
-    return std::hash<uint32_t>{}(key.IP.to_v4().to_uint()) ^
-           (std::hash<uint16_t>{}(key.Port) << 1);
+    return MemberIndex::Mix(key.Packed());
 }
 
-byte* MemberAddr::Write(byte *bBegin, byte *bEnd) const {
-    if (bEnd - bBegin < ByteSize())
-        return nullptr;
-
-    *reinterpret_cast<uint32_t*>(bBegin) = IP.to_v4().to_uint();
-    bBegin += sizeof(uint32_t);
+uint64_t MemberAddr::Packed() const {
+    return (static_cast<uint64_t>(IP.to_v4().to_uint()) << 16) | Port;
+}
 
-    *reinterpret_cast<uint16_t*>(bBegin) = Port;
-    return bBegin + sizeof(uint16_t);
+byte* MemberAddr::Write(byte *bBegin, byte *bEnd) const {
+    return WriteRecord(bBegin, bEnd, *this);
 }
 
 const byte* MemberAddr::Read(const byte *bBegin, const byte *bEnd) {
-    if (bEnd - bBegin < ByteSize())
-        return nullptr;
-
-    IP = boost::asio::ip::address_v4{*reinterpret_cast<const uint32_t*>(bBegin)};
-    bBegin += sizeof(uint32_t);
-
-    Port = *reinterpret_cast<const uint16_t*>(bBegin);
-    return bBegin + sizeof(uint16_t);
+    return ReadRecord(bBegin, bEnd, *this);
 }
 
 size_t MemberAddr::ByteSize() const {
-    return sizeof(uint32_t) + sizeof(uint16_t);
+    return EncodedSize<MemberAddr>;
 }
 
 bool MemberAddr::operator==(const MemberAddr &rhs) const {
@@ -51,41 +41,28 @@ MemberInfo::MemberInfo(MemberInfo::State status, uint32_t incarnation, TimeStamp
 {}
 
 byte* MemberInfo::Write(byte *bBegin, byte *bEnd) const {
-    if (bEnd - bBegin < ByteSize())
-        return nullptr;
-
-    *reinterpret_cast<State*>(bBegin) = Status;
-    bBegin += sizeof(Status);
-
-    *reinterpret_cast<uint32_t*>(bBegin) = Incarnation;
-    bBegin += sizeof(Incarnation);
-
-    *reinterpret_cast<TimeStamp*>(bBegin) = LastUpdate;
-    return bBegin + sizeof(LastUpdate);
+    return WriteRecord(bBegin, bEnd, *this);
 }
 
 const byte* MemberInfo::Read(const byte *bBegin, const byte *bEnd) {
-    if (bEnd - bBegin < ByteSize())
-        return nullptr;
-
-    Status = *reinterpret_cast<const State*>(bBegin);
-    bBegin += sizeof(Status);
-
-    Incarnation = *reinterpret_cast<const uint32_t*>(bBegin);
-    bBegin += sizeof(Incarnation);
-
-    LastUpdate = *reinterpret_cast<const TimeStamp*>(bBegin);
-    return bBegin + sizeof(LastUpdate);
+    return ReadRecord(bBegin, bEnd, *this);
 }
 
 size_t MemberInfo::ByteSize() const {
-    return sizeof(Status) + sizeof(Incarnation) + sizeof(LastUpdate);
+    return EncodedSize<MemberInfo>;
 }
 
 bool MemberInfo::operator==(const MemberInfo &rhs) const {
     return Status == rhs.Status && Incarnation == rhs.Incarnation;
 }
 
+bool MemberInfo::Overrides(const MemberInfo& rhs) const {
+    if (Incarnation != rhs.Incarnation)
+        return Incarnation > rhs.Incarnation;
+
+    return Status > rhs.Status;
+}
+
 Member::Member()
   : Addr{}
   , Info{}
@@ -102,22 +79,7 @@ nlohmann::json Member::ToJSON() const {
     json["addr"]["IP"] = Addr.IP.to_string();
     json["addr"]["port"] = Addr.Port;
 
-    std::string status;
-    switch (Info.Status) {
-        case MemberInfo::State::Alive:
-            status = "alive";
-            break;
-        case MemberInfo::State::Suspicious:
-            status = "suspicious";
-            break;
-        case MemberInfo::State::Dead:
-            status = "dead";
-            break;
-        case MemberInfo::State::Left:
-            status = "left";
-            break;
-    }
-    json["info"]["status"] = status;
+    json["info"]["status"] = StatusName(Info.Status);
     json["info"]["incarnation"] = Info.Incarnation;
 
     return std::move(json);
@@ -128,26 +90,34 @@ bool Member::operator==(const Member &rhs) const {
 }
 
 byte* Member::Write(byte* bBegin, byte* bEnd) const {
-    if (!(bBegin = Addr.Write(bBegin, bEnd)))
-        return nullptr;
-
-    return Info.Write(bBegin, bEnd);
+    return WriteRecord(bBegin, bEnd, *this);
 }
 
 const byte* Member::Read(const byte *bBegin, const byte *bEnd) {
-    if (!(bBegin = Addr.Read(bBegin, bEnd)))
-        return nullptr;
-
-    return Info.Read(bBegin, bEnd);
+    return ReadRecord(bBegin, bEnd, *this);
 }
 
 size_t Member::ByteSize() const {
-    return Addr.ByteSize() + Info.ByteSize();
+    return EncodedSize<Member>;
 }
 
+const size_t MemberTable::ChangeLogCapacity;
+const size_t MemberTable::DigestDepth;
 
 MemberTable::MemberTable()
-  : rGenerator_(std::random_device{}())
+  : MemberTable{std::random_device{}()}
+{}
+
+MemberTable::MemberTable(std::mt19937::result_type seed)
+  : rGenerator_(seed)
+  , sampleMarks_{}
+  , sampleGeneration_{0}
+  , sampleCandidates_{}
+  , probeOrder_{}
+  , probeCursor_{0}
+  , changeLog_{}
+  , version_{0}
+  , digests_{}
 {}
 
 nlohmann::json MemberTable::ToJSON() const {
@@ -164,12 +134,7 @@ byte* MemberTable::Write(byte* bBegin, byte* bEnd) const {
     if (!(bBegin = WriteNumberToBytes(bBegin, bEnd, Size())))
         return nullptr;
 
-    for (const auto& member : set_) {
-        if (!(bBegin = member.Write(bBegin, bEnd)))
-            return nullptr;
-    }
-
-    return bBegin;
+    return WriteRecords(bBegin, bEnd, set_.begin(), set_.size());
 }
 
 const byte* MemberTable::Read(const byte *bBegin, const byte *bEnd) {
@@ -177,79 +142,171 @@ const byte* MemberTable::Read(const byte *bBegin, const byte *bEnd) {
     if (!(bBegin = ReadNumberFromBytes(bBegin, bEnd, size)))
         return nullptr;
 
-    for (size_t i = 0; i < size; ++i) {
-        Member member{};
-        if (!(bBegin = member.Read(bBegin, bEnd)))
-            return nullptr;
-
+    return ReadRecords<Member>(bBegin, bEnd, size, [this](const Member& member) {
         Insert(member);
-    }
-
-    return bBegin;
+    });
 }
 
 size_t MemberTable::ByteSize() const {
-    return sizeof(size_t) + Size()*Member{}.ByteSize();
+    return sizeof(size_t) + Size()*EncodedSize<Member>;
 }
 
-
 // TODO(AndreevSemen): here will be gossip-update logic
 // TODO              : for example, here might be solved timestamps diffs
 // TODO              : or statuses' conflicts
-void MemberTable::Update(const Gossip& gossip, std::deque<Conflict>& conflicts) {
-    auto found = index_.find(gossip.Owner.Addr);
-    if (found == index_.end()) {
-        Insert(gossip.Owner);
-    } else {
-        set_[found->second] = gossip.Owner;
-    }
+template < typename EventsRange, typename TableRange >
+void MemberTable::Merge(const Member& owner, const EventsRange& events, const TableRange& table,
+                        std::deque<Conflict>& conflicts) {
+    // Even the owner can't revive itself without a newer incarnation
+    UpdateRecordIfNewer(owner);
 
-    for (const auto& event : gossip.Events) {
+    for (const auto& event : events) {
         UpdateRecordIfNewer(event);
     }
 
     // Unreliable logic
-    for (const auto& member : gossip.Table.set_) {
-        auto found = index_.find(member.Addr);
-        if (found == index_.end()) {
+    for (const auto& member : table) {
+        auto found = index_.Find(member.Addr.Packed());
+        if (!found) {
             UpdateRecordIfNewer(member);
             continue;
         }
 
-        if (member == set_[found->second])
+        if (member == set_[*found])
             continue;
 
-        if (member.Info.Incarnation > set_[found->second].Info.Incarnation) {
-            UpdateRecordIfNewer(member);
+        if (UpdateRecordIfNewer(member))
             continue;
-        }
 
-        conflicts.emplace_back(Conflict{gossip.Owner.Addr, member.Addr});
+        conflicts.emplace_back(Conflict{owner.Addr, member.Addr});
     }
 }
 
+void MemberTable::Update(const Gossip& gossip, std::deque<Conflict>& conflicts) {
+    Merge(gossip.Owner, gossip.Events, gossip.Table.set_, conflicts);
+}
+
+void MemberTable::Update(const GossipView& gossip, std::deque<Conflict>& conflicts) {
+    Merge(gossip.Owner(), gossip.Events(), gossip.Table(), conflicts);
+}
+
 Member MemberTable::RandomMember() const {
-    return set_[rGenerator_() % Size()];
+    std::uniform_int_distribution<size_t> position{0, Size() - 1};
+    return set_[position(rGenerator_)];
 }
 
 MemberTable MemberTable::GetSubset(size_t size) const {
-    auto setCopy{set_};
-    std::shuffle(setCopy.begin(), setCopy.end(), rGenerator_);
+    std::vector<Member> subset(std::min(size, Size()));
+    subset.resize(Sample(subset.data(), subset.size()));
 
     MemberTable subsetTable;
-    for (size_t i = 0; i < size && i < Size(); ++i) {
-        subsetTable.Insert(setCopy[i]);
+    for (const auto& member : subset) {
+        subsetTable.Insert(member);
     }
 
     return subsetTable;
 }
 
+size_t MemberTable::Sample(Member* out, size_t count, StatusFilter filter) const {
+    if (count == 0 || set_.empty())
+        return 0;
+
+    if (sampleMarks_.size() < set_.size())
+        sampleMarks_.resize(set_.size(), 0);
+    if (++sampleGeneration_ == 0) {
+        std::fill(sampleMarks_.begin(), sampleMarks_.end(), 0);
+        sampleGeneration_ = 1;
+    }
+
+    auto passes = [filter](const Member& member) {
+        return (filter & OnlyStatus(member.Info.Status)) != 0;
+    };
+
+    // Rejection sampling: expected O(count) draws while the picked part
+    // is small and the filter accepts a noticeable part of the table
+    size_t taken = 0;
+    if (count*2 <= Size()) {
+        std::uniform_int_distribution<size_t> position{0, Size() - 1};
+        for (size_t attempts = 4*count + 32; taken < count && attempts != 0; --attempts) {
+            size_t i = position(rGenerator_);
+            if (sampleMarks_[i] == sampleGeneration_ || !passes(set_[i]))
+                continue;
+
+            sampleMarks_[i] = sampleGeneration_;
+            out[taken++] = set_[i];
+        }
+
+        if (taken == count)
+            return taken;
+    }
+
+    // Partial Fisher–Yates over the rest of accepted positions
+    auto& candidates = sampleCandidates_;
+    candidates.clear();
+    for (size_t i = 0; i < set_.size(); ++i) {
+        if (sampleMarks_[i] != sampleGeneration_ && passes(set_[i]))
+            candidates.push_back(i);
+    }
+
+    for (size_t i = 0; taken < count && i < candidates.size(); ++i) {
+        std::uniform_int_distribution<size_t> position{i, candidates.size() - 1};
+        std::swap(candidates[i], candidates[position(rGenerator_)]);
+        out[taken++] = set_[candidates[i]];
+    }
+
+    return taken;
+}
+
+bool MemberTable::RandomTarget(Member& target, const MemberAddr& self) const {
+    // At most one of two distinct members is `self`
+    Member picked[2];
+    size_t count = Sample(picked, 2, LiveStatus);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!(picked[i].Addr == self)) {
+            target = picked[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MemberTable::NextProbeTarget(Member& target, const MemberAddr& self) {
+    // Members inserted since the last call join the current pass
+    for (size_t i = probeOrder_.size(); i < set_.size(); ++i) {
+        probeOrder_.push_back(i);
+        std::uniform_int_distribution<size_t> position{probeCursor_, probeOrder_.size() - 1};
+        std::swap(probeOrder_.back(), probeOrder_[position(rGenerator_)]);
+    }
+
+    // Rest of the current pass plus the whole next one
+    for (size_t checked = 0; checked < 2*probeOrder_.size(); ++checked) {
+        if (probeCursor_ == probeOrder_.size()) {
+            std::shuffle(probeOrder_.begin(), probeOrder_.end(), rGenerator_);
+            probeCursor_ = 0;
+        }
+
+        const auto& member = set_[probeOrder_[probeCursor_++]];
+        if (member.Info.Status == MemberInfo::State::Dead ||
+            member.Info.Status == MemberInfo::State::Left ||
+            member.Addr == self) {
+            continue;
+        }
+
+        target = member;
+        return true;
+    }
+
+    return false;
+}
+
 bool MemberTable::operator==(const MemberTable& rhs) const {
-    for (const auto& pair : index_) {
-        auto othFound = rhs.index_.find(pair.first);
-        if (othFound == rhs.index_.cend())
+    for (const auto& member : set_) {
+        auto othFound = rhs.index_.Find(member.Addr.Packed());
+        if (!othFound)
             return false;
-        if (!(set_[pair.second] == rhs.set_[othFound->second]))
+        if (!(member == rhs.set_[*othFound]))
             return false;
     }
 
@@ -262,40 +319,128 @@ size_t MemberTable::Size() const {
 }
 
 void MemberTable::Insert(const Member& member) {
-    index_.emplace(std::make_pair(member.Addr, set_.size()));
+    if (!index_.Insert(member.Addr.Packed(), set_.size()))
+        return;
+
     set_.push_back(member);
+    if (!digests_.empty())
+        digests_[Range(member.Addr, DigestDepth)] += RecordHash(member);
+}
+
+bool MemberTable::UpdateRecordIfNewer(const Member& member) {
+    return UpdateRecordAt(index_.Find(member.Addr.Packed()), member);
 }
 
-void MemberTable::UpdateRecordIfNewer(const Member& member) {
-    auto found = index_.find(member.Addr);
-    if (found == index_.end()) {
+bool MemberTable::UpdateRecordAt(const size_t* found, const Member& member) {
+    if (!found) {
         Insert(member);
-    } else if (member.Info.LastUpdate.Time < set_[found->second].Info.LastUpdate.Time ||
-               member.Info.Incarnation < set_[found->second].Info.Incarnation) {
-        set_[found->second].Info = member.Info;
+    } else if (member.Info.Overrides(set_[*found].Info)) {
+        if (!digests_.empty()) {
+            digests_[Range(member.Addr, DigestDepth)] += RecordHash(member) - RecordHash(set_[*found]);
+        }
+        set_[*found].Info = member.Info;
+    } else {
+        return false;
+    }
+
+    changeLog_.push_back(member);
+    if (changeLog_.size() > ChangeLogCapacity)
+        changeLog_.pop_front();
+    ++version_;
+
+    return true;
+}
+
+void MemberTable::Clear() {
+    set_.clear();
+    index_.Clear();
+    probeOrder_.clear();
+    probeCursor_ = 0;
+    changeLog_.clear();
+    ++version_;
+    // Rebuilt by the next digest request
+    digests_.clear();
+}
+
+uint64_t MemberTable::Digest() const {
+    std::vector<uint64_t> root;
+    RangeDigests(0, root);
+    return root.front();
+}
+
+void MemberTable::RangeDigests(size_t level, std::vector<uint64_t>& digests) const {
+    if (digests_.empty()) {
+        digests_.assign(size_t{1} << DigestDepth, 0);
+        for (const auto& member : set_)
+            digests_[Range(member.Addr, DigestDepth)] += RecordHash(member);
+    }
+
+    level = std::min(level, DigestDepth);
+    digests.assign(size_t{1} << level, 0);
+    for (size_t leaf = 0; leaf < digests_.size(); ++leaf)
+        digests[leaf >> (DigestDepth - level)] += digests_[leaf];
+}
+
+size_t MemberTable::Range(const MemberAddr& addr, size_t level) {
+    if (level == 0)
+        return 0;
+
+    // Top bits, the index takes its slots from the low ones
+    return static_cast<size_t>(MemberIndex::Mix(addr.Packed()) >> (64 - std::min(level, DigestDepth)));
+}
+
+void MemberTable::RangeRecords(size_t level, const std::vector<bool>& ranges, std::vector<Member>& out) const {
+    for (const auto& member : set_) {
+        size_t range = Range(member.Addr, level);
+        if (range < ranges.size() && ranges[range])
+            out.push_back(member);
     }
 }
 
+uint64_t MemberTable::RecordHash(const Member& member) {
+    uint64_t info = (static_cast<uint64_t>(member.Info.Incarnation) << 2) | member.Info.Status;
+    return MemberIndex::Mix(member.Addr.Packed() ^ MemberIndex::Mix(info));
+}
+
+const Member* MemberTable::Find(const MemberAddr& addr) const {
+    auto found = index_.Find(addr.Packed());
+    return found ? &set_[*found] : nullptr;
+}
+
+uint64_t MemberTable::Version() const {
+    return version_;
+}
+
+bool MemberTable::ChangesSince(uint64_t& version, std::vector<Member>& changes) const {
+    uint64_t oldest = version_ - changeLog_.size();
+    bool complete = version >= oldest;
+    if (version > version_)
+        version = version_;
+
+    for (auto it = changeLog_.begin() + (std::max(version, oldest) - oldest); it != changeLog_.end(); ++it)
+        changes.push_back(*it);
+
+    version = version_;
+    return complete;
+}
+
 
 const byte* Gossip::Read(const byte *bBegin, const byte* bEnd) {
-    size_t size = 0;
-    if (!(bBegin = ReadNumberFromBytes(bBegin, bEnd, TTL)))
-        return nullptr;
-    if (!(bBegin = Owner.Read(bBegin, bEnd)))
-        return nullptr;
-    if (!(bBegin = Dest.Read(bBegin, bEnd)))
-        return nullptr;
-    if (!(bBegin = ReadNumberFromBytes(bBegin, bEnd, size)))
+    GossipView view;
+    if (!(bBegin = view.Parse(bBegin, bEnd)))
         return nullptr;
 
-    for (size_t i = 0; i < size; ++i) {
-        Member member{};
-        if (!(bBegin = member.Read(bBegin, bEnd)))
-            return nullptr;
-        Events.push_back(member);
-    }
+    Type = view.Type();
+    Sequence = view.Sequence();
+    Target = view.Target();
+    TTL = view.TTL();
+    Owner = view.Owner();
+    Dest = view.Dest();
+    Events.assign(view.Events().begin(), view.Events().end());
+    for (const auto& member : view.Table())
+        Table.Insert(member);
 
-    return Table.Read(bBegin, bEnd);
+    return bBegin;
 }
 
 
@@ -308,26 +453,478 @@ byte* Gossip::Write(byte *bBegin, byte *bEnd) const {
         return nullptr;
     if (!(bBegin = WriteNumberToBytes(bBegin, bEnd, Events.size())))
         return nullptr;
-
-    for (const auto& member : Events)
-        if (!(bBegin = member.Write(bBegin, bEnd)))
-            return nullptr;
+    if (!(bBegin = WriteRecords(bBegin, bEnd, Events.begin(), Events.size())))
+        return nullptr;
 
     return Table.Write(bBegin, bEnd);
 }
 
 size_t Gossip::ByteSize() const {
     return sizeof(TTL) +
-           Owner.ByteSize() +
-           Dest.ByteSize() +
-           sizeof(size_t) + Owner.ByteSize()*Events.size() +
+           2*EncodedSize<Member> +
+           sizeof(size_t) + EncodedSize<Member>*Events.size() +
            Table.ByteSize();
 }
 
+byte* Gossip::Write(byte* bBegin, byte* bEnd, WireVersion version) const {
+    if (version == WireVersion::V1 && Type == MessageKind::Gossip)
+        return Write(bBegin, bEnd);
+
+    if (!(bBegin = WriteWireHeader(bBegin, bEnd, static_cast<uint8_t>(Type))))
+        return nullptr;
+
+    uint32_t prevIncarnation = 0;
+    if (Type != MessageKind::Gossip && !(bBegin = WriteVarint(bBegin, bEnd, Sequence)))
+        return nullptr;
+    if (Type == MessageKind::PingReq && !(bBegin = WriteMemberV2(bBegin, bEnd, Target, prevIncarnation)))
+        return nullptr;
+
+    if (!(bBegin = WriteVarint(bBegin, bEnd, TTL)))
+        return nullptr;
+
+    prevIncarnation = 0;
+    if (!(bBegin = WriteMemberV2(bBegin, bEnd, Owner, prevIncarnation)))
+        return nullptr;
+    prevIncarnation = 0;
+    if (!(bBegin = WriteMemberV2(bBegin, bEnd, Dest, prevIncarnation)))
+        return nullptr;
+
+    if (!(bBegin = WriteVarint(bBegin, bEnd, Events.size())))
+        return nullptr;
+    prevIncarnation = 0;
+    for (const auto& member : Events)
+        if (!(bBegin = WriteMemberV2(bBegin, bEnd, member, prevIncarnation)))
+            return nullptr;
+
+    if (!(bBegin = WriteVarint(bBegin, bEnd, Table.Size())))
+        return nullptr;
+    prevIncarnation = 0;
+    for (const auto& member : Table.set_)
+        if (!(bBegin = WriteMemberV2(bBegin, bEnd, member, prevIncarnation)))
+            return nullptr;
+
+    return bBegin;
+}
+
+size_t Gossip::ByteSize(WireVersion version) const {
+    if (version == WireVersion::V1 && Type == MessageKind::Gossip)
+        return ByteSize();
+
+    size_t size = WireHeaderSize + VarintSize(TTL);
+
+    uint32_t prevIncarnation = 0;
+    if (Type != MessageKind::Gossip)
+        size += VarintSize(Sequence);
+    if (Type == MessageKind::PingReq)
+        size += MemberV2Size(Target, prevIncarnation);
+
+    prevIncarnation = 0;
+    size += MemberV2Size(Owner, prevIncarnation);
+    prevIncarnation = 0;
+    size += MemberV2Size(Dest, prevIncarnation);
+
+    size += VarintSize(Events.size());
+    prevIncarnation = 0;
+    for (const auto& member : Events)
+        size += MemberV2Size(member, prevIncarnation);
+
+    size += VarintSize(Table.Size());
+    prevIncarnation = 0;
+    for (const auto& member : Table.set_)
+        size += MemberV2Size(member, prevIncarnation);
+
+    return size;
+}
+
 bool Gossip::operator==(const Gossip& rhs) const {
     return TTL == rhs.TTL &&
            Owner == rhs.Owner &&
            Dest == rhs.Dest &&
            Events == rhs.Events &&
-           Table == rhs.Table;
+           Table == rhs.Table &&
+           Type == rhs.Type &&
+           Sequence == rhs.Sequence &&
+           (Type != MessageKind::PingReq || Target == rhs.Target);
+}
+
+
+GossipBatch::GossipBatch()
+  : gossips_{}
+  , size_{0}
+{}
+
+Gossip& GossipBatch::Next() {
+    if (size_ == gossips_.size()) {
+        gossips_.emplace_back();
+        return gossips_[size_++];
+    }
+
+    Gossip& gossip = gossips_[size_++];
+    gossip.TTL = 0;
+    gossip.Owner = Member{};
+    gossip.Dest = Member{};
+    gossip.Events.clear();
+    gossip.Table.Clear();
+    gossip.Type = MessageKind::Gossip;
+    gossip.Sequence = 0;
+    gossip.Target = Member{};
+
+    return gossip;
+}
+
+void GossipBatch::Clear() {
+    size_ = 0;
+}
+
+size_t GossipBatch::Size() const {
+    return size_;
+}
+
+bool GossipBatch::Empty() const {
+    return size_ == 0;
+}
+
+std::vector<Gossip>::const_iterator GossipBatch::begin() const {
+    return gossips_.cbegin();
+}
+
+std::vector<Gossip>::const_iterator GossipBatch::end() const {
+    return gossips_.cbegin() + size_;
+}
+
+
+MergeBatch::MergeBatch()
+  : records_{}
+  , positions_{}
+  , marks_{}
+  , slots_{}
+  , generation_{1}
+  , absent_{}
+  , added_{0}
+{}
+
+void MergeBatch::Add(const MemberTable& table, const Gossip& gossip, std::deque<Conflict>& conflicts) {
+    Add(table, gossip.Owner, gossip.Events, gossip.Table.set_, conflicts);
+}
+
+void MergeBatch::Add(const MemberTable& table, const GossipView& gossip, std::deque<Conflict>& conflicts) {
+    Add(table, gossip.Owner(), gossip.Events(), gossip.Table(), conflicts);
+}
+
+template < typename EventsRange, typename TableRange >
+void MergeBatch::Add(const MemberTable& table, const Member& owner, const EventsRange& events,
+                     const TableRange& tableRecords, std::deque<Conflict>& conflicts) {
+    Reduce(table, owner);
+
+    for (const auto& event : events) {
+        Reduce(table, event);
+    }
+
+    // Same rule as `MemberTable::Merge()`
+    for (const auto& member : tableRecords) {
+        if (Reduce(table, member))
+            conflicts.emplace_back(Conflict{owner.Addr, member.Addr});
+    }
+}
+
+bool MergeBatch::Reduce(const MemberTable& table, const Member& member) {
+    ++added_;
+
+    uint64_t key = member.Addr.Packed();
+    auto found = table.index_.Find(key);
+    if (!found) {
+        auto slot = absent_.Find(key);
+        if (!slot) {
+            absent_.Insert(key, records_.size());
+            records_.push_back(member);
+            positions_.push_back(NoRecord);
+        } else if (member.Info.Overrides(records_[*slot].Info)) {
+            records_[*slot].Info = member.Info;
+        }
+        return false;
+    }
+
+    // Table positions stay valid until `Apply()`. Copies of what the
+    // table already knows, the most common ones, stop here
+    size_t position = *found;
+    const MemberInfo& local = table.set_[position].Info;
+    if (!member.Info.Overrides(local))
+        return !(member.Info == local);
+
+    if (marks_.size() < table.Size()) {
+        marks_.resize(table.Size(), 0);
+        slots_.resize(table.Size());
+    }
+
+    if (marks_[position] != generation_) {
+        marks_[position] = generation_;
+        slots_[position] = records_.size();
+        records_.push_back(member);
+        positions_.push_back(position);
+    } else if (member.Info.Overrides(records_[slots_[position]].Info)) {
+        records_[slots_[position]].Info = member.Info;
+    }
+
+    return false;
+}
+
+size_t MergeBatch::Apply(MemberTable& table) const {
+    size_t changed = 0;
+    for (size_t i = 0; i < records_.size(); ++i) {
+        const size_t* position = positions_[i] == NoRecord ? nullptr : &positions_[i];
+        if (table.UpdateRecordAt(position, records_[i]))
+            ++changed;
+    }
+
+    return changed;
+}
+
+void MergeBatch::Clear() {
+    records_.clear();
+    positions_.clear();
+    absent_.Clear();
+    added_ = 0;
+
+    if (++generation_ == 0) {
+        std::fill(marks_.begin(), marks_.end(), 0);
+        generation_ = 1;
+    }
+}
+
+size_t MergeBatch::Size() const {
+    return records_.size();
+}
+
+size_t MergeBatch::Coalesced() const {
+    return added_ - records_.size();
+}
+
+
+GossipView::MemberRange::Iterator::Iterator()
+  : record_{nullptr}
+  , next_{nullptr}
+  , end_{nullptr}
+  , version_{WireVersion::V1}
+  , prevIncarnation_{0}
+  , current_{}
+{}
+
+GossipView::MemberRange::Iterator::Iterator(const byte* record, const byte* end, WireVersion version)
+  : record_{record}
+  , next_{record}
+  , end_{end}
+  , version_{version}
+  , prevIncarnation_{0}
+  , current_{}
+{
+    Decode();
+}
+
+const Member& GossipView::MemberRange::Iterator::operator*() const {
+    return current_;
+}
+
+const Member* GossipView::MemberRange::Iterator::operator->() const {
+    return &current_;
+}
+
+GossipView::MemberRange::Iterator& GossipView::MemberRange::Iterator::operator++() {
+    record_ = next_;
+    Decode();
+    return *this;
+}
+
+GossipView::MemberRange::Iterator GossipView::MemberRange::Iterator::operator++(int) {
+    Iterator old{*this};
+    ++*this;
+    return old;
+}
+
+bool GossipView::MemberRange::Iterator::operator==(const Iterator& rhs) const {
+    return record_ == rhs.record_;
+}
+
+bool GossipView::MemberRange::Iterator::operator!=(const Iterator& rhs) const {
+    return record_ != rhs.record_;
+}
+
+void GossipView::MemberRange::Iterator::Decode() {
+    if (record_ == end_)
+        return;
+
+    // Bounds were checked once by `GossipView::Parse()`
+    if (version_ == WireVersion::V1) {
+        Codec<Member>::Load(record_, current_);
+        next_ = record_ + EncodedSize<Member>;
+    } else {
+        next_ = ReadMemberV2(record_, end_, current_, prevIncarnation_);
+    }
+
+    if (!next_)
+        record_ = next_ = end_;
+}
+
+GossipView::MemberRange::MemberRange()
+  : begin_{nullptr}
+  , end_{nullptr}
+  , size_{0}
+  , version_{WireVersion::V1}
+{}
+
+GossipView::MemberRange::MemberRange(const byte* begin, const byte* end, size_t size, WireVersion version)
+  : begin_{begin}
+  , end_{end}
+  , size_{size}
+  , version_{version}
+{}
+
+size_t GossipView::MemberRange::Size() const {
+    return size_;
+}
+
+GossipView::MemberRange::Iterator GossipView::MemberRange::begin() const {
+    return Iterator{begin_, end_, version_};
+}
+
+GossipView::MemberRange::Iterator GossipView::MemberRange::end() const {
+    return Iterator{end_, end_, version_};
+}
+
+
+GossipView::GossipView()
+  : version_{WireVersion::V1}
+  , flags_{0}
+  , ttl_{0}
+  , sequence_{0}
+  , target_{}
+  , owner_{}
+  , dest_{}
+  , events_{}
+  , table_{}
+{}
+
+const byte* GossipView::Parse(const byte* bBegin, const byte* bEnd) {
+    if (IsWireV2(bBegin, bEnd))
+        return ParseV2(bBegin, bEnd);
+
+    return ParseV1(bBegin, bEnd);
+}
+
+WireVersion GossipView::Version() const {
+    return version_;
+}
+
+uint8_t GossipView::Flags() const {
+    return flags_;
+}
+
+MessageKind GossipView::Type() const {
+    return static_cast<MessageKind>(flags_ & MessageKindMask);
+}
+
+uint32_t GossipView::Sequence() const {
+    return sequence_;
+}
+
+const Member& GossipView::Target() const {
+    return target_;
+}
+
+uint16_t GossipView::TTL() const {
+    return ttl_;
+}
+
+const Member& GossipView::Owner() const {
+    return owner_;
+}
+
+const Member& GossipView::Dest() const {
+    return dest_;
+}
+
+const GossipView::MemberRange& GossipView::Events() const {
+    return events_;
+}
+
+const GossipView::MemberRange& GossipView::Table() const {
+    return table_;
+}
+
+const byte* GossipView::ParseV1(const byte* bBegin, const byte* bEnd) {
+    version_ = WireVersion::V1;
+    flags_ = 0;
+    sequence_ = 0;
+
+    if (!(bBegin = ReadNumberFromBytes(bBegin, bEnd, ttl_)))
+        return nullptr;
+    if (!(bBegin = ReadRecord(bBegin, bEnd, owner_)))
+        return nullptr;
+    if (!(bBegin = ReadRecord(bBegin, bEnd, dest_)))
+        return nullptr;
+
+    for (auto range : {&events_, &table_}) {
+        size_t size = 0;
+        if (!(bBegin = ReadNumberFromBytes(bBegin, bEnd, size)))
+            return nullptr;
+        if ((bEnd - bBegin) / EncodedSize<Member> < size)
+            return nullptr;
+        // Records are decoded without checks later
+        if (!ValidRecords<Member>(bBegin, size))
+            return nullptr;
+
+        const byte* end = bBegin + size*EncodedSize<Member>;
+        *range = MemberRange{bBegin, end, size, WireVersion::V1};
+        bBegin = end;
+    }
+
+    return bBegin;
+}
+
+const byte* GossipView::ParseV2(const byte* bBegin, const byte* bEnd) {
+    version_ = WireVersion::V2;
+
+    if (!(bBegin = ReadWireHeader(bBegin, bEnd, flags_)))
+        return nullptr;
+
+    uint32_t prevIncarnation = 0;
+    sequence_ = 0;
+    if (Type() != MessageKind::Gossip) {
+        uint64_t sequence = 0;
+        if (!(bBegin = ReadVarint(bBegin, bEnd, sequence)) || sequence > UINT32_MAX)
+            return nullptr;
+        sequence_ = static_cast<uint32_t>(sequence);
+    }
+    if (Type() == MessageKind::PingReq && !(bBegin = ReadMemberV2(bBegin, bEnd, target_, prevIncarnation)))
+        return nullptr;
+
+    uint64_t ttl = 0;
+    if (!(bBegin = ReadVarint(bBegin, bEnd, ttl)) || ttl > UINT16_MAX)
+        return nullptr;
+    ttl_ = static_cast<uint16_t>(ttl);
+
+    prevIncarnation = 0;
+    if (!(bBegin = ReadMemberV2(bBegin, bEnd, owner_, prevIncarnation)))
+        return nullptr;
+    prevIncarnation = 0;
+    if (!(bBegin = ReadMemberV2(bBegin, bEnd, dest_, prevIncarnation)))
+        return nullptr;
+
+    for (auto range : {&events_, &table_}) {
+        uint64_t size = 0;
+        if (!(bBegin = ReadVarint(bBegin, bEnd, size)))
+            return nullptr;
+
+        // Records have variable length, so all of them are walked once
+        const byte* begin = bBegin;
+        Member member{};
+        prevIncarnation = 0;
+        for (uint64_t i = 0; i < size; ++i) {
+            if (!(bBegin = ReadMemberV2(bBegin, bEnd, member, prevIncarnation)))
+                return nullptr;
+        }
+
+        *range = MemberRange{begin, bBegin, static_cast<size_t>(size), WireVersion::V2};
+    }
+
+    return bBegin;
 }
@@ -0,0 +1,209 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <arpa/inet.h>
+
+#include <cstring>
+
+#include <types.hpp>
+#include <wire.hpp>
+
+bool IsWireV2(const byte* bBegin, const byte* bEnd) {
+    return bEnd - bBegin >= 2 &&
+           bBegin[0] == WireMagic[0] &&
+           bBegin[1] == WireMagic[1];
+}
+
+byte* WriteWireHeader(byte* bBegin, byte* bEnd, uint8_t flags) {
+    if (static_cast<size_t>(bEnd - bBegin) < WireHeaderSize)
+        return nullptr;
+
+    bBegin[0] = WireMagic[0];
+    bBegin[1] = WireMagic[1];
+    bBegin[2] = static_cast<byte>(WireVersion::V2);
+    bBegin[3] = flags;
+
+    return bBegin + WireHeaderSize;
+}
+
+const byte* ReadWireHeader(const byte* bBegin, const byte* bEnd, uint8_t& flags) {
+    if (static_cast<size_t>(bEnd - bBegin) < WireHeaderSize || !IsWireV2(bBegin, bEnd))
+        return nullptr;
+    if (bBegin[2] != static_cast<byte>(WireVersion::V2))
+        return nullptr;
+
+    flags = bBegin[3];
+    return bBegin + WireHeaderSize;
+}
+
+size_t VarintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+
+    return size;
+}
+
+byte* WriteVarint(byte* bBegin, byte* bEnd, uint64_t value) {
+    if (static_cast<size_t>(bEnd - bBegin) < VarintSize(value))
+        return nullptr;
+
+    while (value >= 0x80) {
+        *bBegin++ = static_cast<byte>(value) | 0x80;
+        value >>= 7;
+    }
+    *bBegin++ = static_cast<byte>(value);
+
+    return bBegin;
+}
+
+const byte* ReadVarint(const byte* bBegin, const byte* bEnd, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (bBegin == bEnd)
+            return nullptr;
+
+        byte part = *bBegin++;
+        value |= static_cast<uint64_t>(part & 0x7F) << shift;
+        if (!(part & 0x80))
+            return bBegin;
+    }
+
+    // Longer than any 64-bit number
+    return nullptr;
+}
+
+uint64_t ZigZagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+namespace {
+
+// Fixed part: IP, port and state byte
+const size_t MemberV2FixedSize = sizeof(uint32_t) + sizeof(uint16_t) + 1;
+
+int64_t IncarnationDelta(uint32_t incarnation, uint32_t prevIncarnation) {
+    return static_cast<int64_t>(incarnation) - static_cast<int64_t>(prevIncarnation);
+}
+
+// Packed address (`MemberAddr::Packed()`): IP and port
+const size_t SuspectorSize = sizeof(uint32_t) + sizeof(uint16_t);
+
+bool WritesSuspector(const Member& member) {
+    return member.Info.Status == MemberInfo::State::Suspicious && member.Info.Suspector != 0;
+}
+
+} // namespace
+
+size_t MemberV2Size(const Member& member, uint32_t& prevIncarnation) {
+    size_t size = MemberV2FixedSize +
+                  VarintSize(ZigZagEncode(IncarnationDelta(member.Info.Incarnation, prevIncarnation)));
+    if (member.Info.LastUpdate.Time != 0)
+        size += VarintSize(member.Info.LastUpdate.Time);
+    if (WritesSuspector(member))
+        size += SuspectorSize;
+
+    prevIncarnation = member.Info.Incarnation;
+    return size;
+}
+
+byte* WriteMemberV2(byte* bBegin, byte* bEnd, const Member& member, uint32_t& prevIncarnation) {
+    if (static_cast<size_t>(bEnd - bBegin) < MemberV2FixedSize)
+        return nullptr;
+
+    uint32_t ip = htonl(member.Addr.IP.to_v4().to_uint());
+    std::memcpy(bBegin, &ip, sizeof(ip));
+    bBegin += sizeof(ip);
+
+    uint16_t port = htons(member.Addr.Port);
+    std::memcpy(bBegin, &port, sizeof(port));
+    bBegin += sizeof(port);
+
+    uint8_t stateFlags = static_cast<uint8_t>(member.Info.Status) & StateMask;
+    if (member.Info.LastUpdate.Time != 0)
+        stateFlags |= HasTimestamp;
+    if (WritesSuspector(member))
+        stateFlags |= HasSuspector;
+    *bBegin++ = stateFlags;
+
+    int64_t delta = IncarnationDelta(member.Info.Incarnation, prevIncarnation);
+    if (!(bBegin = WriteVarint(bBegin, bEnd, ZigZagEncode(delta))))
+        return nullptr;
+    prevIncarnation = member.Info.Incarnation;
+
+    if ((stateFlags & HasTimestamp) && !(bBegin = WriteVarint(bBegin, bEnd, member.Info.LastUpdate.Time)))
+        return nullptr;
+
+    if (stateFlags & HasSuspector) {
+        if (static_cast<size_t>(bEnd - bBegin) < SuspectorSize)
+            return nullptr;
+
+        uint32_t suspectorIP = htonl(static_cast<uint32_t>(member.Info.Suspector >> 16));
+        std::memcpy(bBegin, &suspectorIP, sizeof(suspectorIP));
+        bBegin += sizeof(suspectorIP);
+
+        uint16_t suspectorPort = htons(static_cast<uint16_t>(member.Info.Suspector));
+        std::memcpy(bBegin, &suspectorPort, sizeof(suspectorPort));
+        bBegin += sizeof(suspectorPort);
+    }
+
+    return bBegin;
+}
+
+const byte* ReadMemberV2(const byte* bBegin, const byte* bEnd, Member& member, uint32_t& prevIncarnation) {
+    if (static_cast<size_t>(bEnd - bBegin) < MemberV2FixedSize)
+        return nullptr;
+
+    uint32_t ip = 0;
+    std::memcpy(&ip, bBegin, sizeof(ip));
+    member.Addr.IP = boost::asio::ip::address_v4{ntohl(ip)};
+    bBegin += sizeof(ip);
+
+    uint16_t port = 0;
+    std::memcpy(&port, bBegin, sizeof(port));
+    member.Addr.Port = ntohs(port);
+    bBegin += sizeof(port);
+
+    uint8_t stateFlags = *bBegin++;
+    member.Info.Status = static_cast<MemberInfo::State>(stateFlags & StateMask);
+
+    uint64_t delta = 0;
+    if (!(bBegin = ReadVarint(bBegin, bEnd, delta)))
+        return nullptr;
+    int64_t incarnation = static_cast<int64_t>(prevIncarnation) + ZigZagDecode(delta);
+    if (incarnation < 0 || incarnation > UINT32_MAX)
+        return nullptr;
+    member.Info.Incarnation = static_cast<uint32_t>(incarnation);
+    prevIncarnation = member.Info.Incarnation;
+
+    member.Info.LastUpdate.Time = 0;
+    if (stateFlags & HasTimestamp) {
+        uint64_t time = 0;
+        if (!(bBegin = ReadVarint(bBegin, bEnd, time)) || time > UINT32_MAX)
+            return nullptr;
+        member.Info.LastUpdate.Time = static_cast<uint32_t>(time);
+    }
+
+    member.Info.Suspector = 0;
+    if (stateFlags & HasSuspector) {
+        if (static_cast<size_t>(bEnd - bBegin) < SuspectorSize)
+            return nullptr;
+
+        uint32_t suspectorIP = 0;
+        std::memcpy(&suspectorIP, bBegin, sizeof(suspectorIP));
+        bBegin += sizeof(suspectorIP);
+
+        uint16_t suspectorPort = 0;
+        std::memcpy(&suspectorPort, bBegin, sizeof(suspectorPort));
+        bBegin += sizeof(suspectorPort);
+
+        member.Info.Suspector = (static_cast<uint64_t>(ntohl(suspectorIP)) << 16) | ntohs(suspectorPort);
+    }
+
+    return bBegin;
+}
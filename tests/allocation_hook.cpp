@@ -0,0 +1,116 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <cstdlib>
+#include <new>
+
+#include "allocation_hook.hpp"
+
+// Kept in a translation unit of its own, so the replacements are never
+// inlined into callers
+
+namespace {
+
+thread_local AllocationCounter* active = nullptr;
+
+void* Allocate(std::size_t size) {
+    AllocationCounter::Record();
+    return std::malloc(size ? size : 1);
+}
+
+void* AllocateAligned(std::size_t size, std::align_val_t alignment) {
+    AllocationCounter::Record();
+    auto align = static_cast<std::size_t>(alignment);
+    // `aligned_alloc()` needs a multiple of the alignment
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+} // namespace
+
+AllocationCounter::AllocationCounter()
+  : count_{0}
+  , outer_{active}
+{
+    active = this;
+}
+
+AllocationCounter::~AllocationCounter() {
+    active = outer_;
+}
+
+std::size_t AllocationCounter::Count() const {
+    return count_;
+}
+
+void AllocationCounter::Record() {
+    for (AllocationCounter* counter = active; counter; counter = counter->outer_)
+        ++counter->count_;
+}
+
+
+void* operator new(std::size_t size) {
+    if (void* memory = Allocate(size))
+        return memory;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* memory = AllocateAligned(size, alignment))
+        return memory;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
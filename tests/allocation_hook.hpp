@@ -0,0 +1,29 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef TESTS_ALLOCATION_HOOK_HPP_
+#define TESTS_ALLOCATION_HOOK_HPP_
+
+#include <cstddef>
+
+// Counts heap allocations made by the current thread while alive.
+// Global `operator new`/`operator delete` are replaced by
+// allocation_hook.cpp, so only binaries linking it can use it
+class AllocationCounter {
+private:
+    std::size_t count_;
+    AllocationCounter* outer_;
+
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    std::size_t Count() const;
+
+    // Called by the replaced `operator new`s
+    static void Record();
+};
+
+#endif // TESTS_ALLOCATION_HOOK_HPP_
@@ -0,0 +1,98 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <behavior.hpp>
+
+#include "allocation_hook.hpp"
+#include "members.hpp"
+
+TEST(AllocationCounter, CountsScopedAllocations) {
+    size_t innerCount = 0;
+    size_t outerCount = 0;
+    {
+        AllocationCounter outer;
+        {
+            AllocationCounter inner;
+            std::vector<int> first(8, 1);
+            std::vector<int> second{first};
+            innerCount = inner.Count();
+        }
+        outerCount = outer.Count();
+    }
+
+    // Outer counters see allocations of the inner scopes
+    EXPECT_EQ(innerCount, 2);
+    EXPECT_EQ(outerCount, 2);
+}
+
+TEST(Pipeline, SteadyStateRoundDoesNotAllocate) {
+    const uint16_t size = 64;
+    MemberTable table = MakeTable(size);
+    GossipPacker packer{1400, WireVersion::V2};
+    BufferPool pool{1500, 64};
+
+    // Gossips of peers carrying what the table already knows
+    MemberTable peerTable = MakeTable(size);
+    GossipPacker peerPacker{1400, WireVersion::V2};
+    std::vector<std::vector<byte>> datagrams;
+    for (uint16_t port = 2; port < 10; ++port) {
+        Gossip gossip = peerPacker.Pack(3, MakeMember(port, MemberInfo::State::Alive, port),
+                                          MakeMember(1, MemberInfo::State::Alive, 1), peerTable);
+        datagrams.emplace_back(gossip.ByteSize(WireVersion::V2));
+        byte* end = gossip.Write(datagrams.back().data(), datagrams.back().data() + datagrams.back().size(),
+                                 WireVersion::V2);
+        ASSERT_NE(end, nullptr);
+        datagrams.back().resize(end - datagrams.back().data());
+    }
+
+    std::vector<Packet> packets;
+    packets.reserve(datagrams.size());
+    MergeBatch merge;
+    std::deque<Conflict> conflicts;
+    GossipBatch out;
+    size_t written = 0;
+
+    auto round = [&] {
+        packets.clear();
+        for (const auto& datagram : datagrams) {
+            Packet packet{};
+            packet.Bytes = pool.Acquire();
+            std::copy(datagram.begin(), datagram.end(), packet.Bytes.Begin());
+            packet.Bytes.Shrink(datagram.size());
+            packet.View.Parse(packet.Bytes.Begin(), packet.Bytes.End());
+            packets.push_back(std::move(packet));
+        }
+
+        conflicts.clear();
+        UpdateTable(table, packets, merge, conflicts);
+
+        out.Clear();
+        GenerateGossips(table, packer, packets, out);
+        for (const auto& gossip : out) {
+            ByteBuffer datagram = pool.Acquire();
+            if (gossip.Write(datagram.Begin(), datagram.End(), WireVersion::V2))
+                ++written;
+        }
+    };
+
+    // Initial changes are disseminated and retired, storage grows
+    for (size_t i = 0; i < 10; ++i)
+        round();
+
+    written = 0;
+    size_t allocations = 0;
+    {
+        AllocationCounter counter;
+        for (size_t i = 0; i < 100; ++i)
+            round();
+        allocations = counter.Count();
+    }
+
+    EXPECT_EQ(allocations, 0);
+    EXPECT_EQ(written, 100 * datagrams.size());
+    EXPECT_EQ(conflicts.size(), 0);
+    EXPECT_EQ(pool.Available(), pool.Capacity() - packets.size());
+}
@@ -0,0 +1,155 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+#include <boost/asio.hpp>
+
+#include <connector.hpp>
+
+#include "members.hpp"
+
+using boost::asio::local::stream_protocol;
+
+namespace {
+
+const char* SocketPath = "./connector_unittests.sock";
+
+// Runs server handlers until the client gets a whole line
+nlohmann::json ReadLine(boost::asio::io_service& ioService, stream_protocol::socket& client,
+                        boost::asio::streambuf& buffer) {
+    while (true) {
+        ioService.poll();
+        ioService.restart();
+
+        auto begin = boost::asio::buffers_begin(buffer.data());
+        auto end = boost::asio::buffers_end(buffer.data());
+        auto newline = std::find(begin, end, '\n');
+        if (newline != end) {
+            std::string line{begin, newline};
+            buffer.consume(line.size() + 1);
+            return nlohmann::json::parse(line);
+        }
+
+        if (client.available() > 0) {
+            auto chunk = buffer.prepare(client.available());
+            buffer.commit(client.read_some(chunk));
+        }
+    }
+}
+
+void Connect(boost::asio::io_service& ioService, stream_protocol::socket& client, const std::string& request) {
+    client.connect(stream_protocol::endpoint{SocketPath});
+    boost::asio::write(client, boost::asio::buffer(request + "\n"));
+    ioService.poll();
+    ioService.restart();
+}
+
+} // namespace
+
+TEST(AppConnector, SnapshotThenChanges) {
+    boost::asio::io_service ioService;
+    MemberTable table;
+    table.UpdateRecordIfNewer(MakeMember(1, MemberInfo::State::Alive, 0));
+
+    AppConnector connector{ioService, table, SocketPath};
+    connector.Start();
+
+    stream_protocol::socket client{ioService};
+    boost::asio::streambuf buffer;
+    Connect(ioService, client, "{}");
+
+    auto snapshot = ReadLine(ioService, client, buffer);
+    EXPECT_EQ(snapshot["type"], "snapshot");
+    EXPECT_EQ(snapshot["version"], table.Version());
+    EXPECT_EQ(snapshot["epoch"], connector.Epoch());
+    EXPECT_EQ(snapshot["members"].size(), 1);
+
+    table.UpdateRecordIfNewer(MakeMember(1, MemberInfo::State::Suspicious, 0));
+    table.UpdateRecordIfNewer(MakeMember(2, MemberInfo::State::Alive, 0));
+    connector.Publish();
+
+    auto first = ReadLine(ioService, client, buffer);
+    EXPECT_EQ(first["type"], "change");
+    EXPECT_EQ(first["version"], snapshot["version"].get<uint64_t>() + 1);
+    EXPECT_EQ(first["member"]["info"]["status"], "suspicious");
+
+    auto second = ReadLine(ioService, client, buffer);
+    EXPECT_EQ(second["version"], table.Version());
+    EXPECT_EQ(second["member"]["addr"]["port"], 2);
+
+    EXPECT_EQ(connector.Clients(), 1);
+    std::remove(SocketPath);
+}
+
+TEST(AppConnector, Resume) {
+    boost::asio::io_service ioService;
+    MemberTable table;
+    table.UpdateRecordIfNewer(MakeMember(1, MemberInfo::State::Alive, 0));
+
+    AppConnector connector{ioService, table, SocketPath};
+    connector.Start();
+
+    uint64_t seen = table.Version();
+    table.UpdateRecordIfNewer(MakeMember(2, MemberInfo::State::Alive, 0));
+    connector.Publish();
+
+    // Missed changes only
+    nlohmann::json request = {{"epoch", connector.Epoch()}, {"since", seen}};
+    stream_protocol::socket client{ioService};
+    boost::asio::streambuf buffer;
+    Connect(ioService, client, request.dump());
+
+    auto change = ReadLine(ioService, client, buffer);
+    EXPECT_EQ(change["type"], "change");
+    EXPECT_EQ(change["version"], seen + 1);
+    EXPECT_EQ(change["member"]["addr"]["port"], 2);
+
+    // Another epoch means another daemon run
+    request["epoch"] = connector.Epoch() + 1;
+    stream_protocol::socket stranger{ioService};
+    boost::asio::streambuf strangerBuffer;
+    Connect(ioService, stranger, request.dump());
+
+    EXPECT_EQ(ReadLine(ioService, stranger, strangerBuffer)["type"], "snapshot");
+
+    // Malformed resume fields get a snapshot too
+    for (const auto& malformed : {R"({"epoch":"x","since":1})", R"({"epoch":-1,"since":1})",
+                                  R"({"epoch":1.5})", R"([1,2])"}) {
+        stream_protocol::socket other{ioService};
+        boost::asio::streambuf otherBuffer;
+        Connect(ioService, other, malformed);
+        EXPECT_EQ(ReadLine(ioService, other, otherBuffer)["type"], "snapshot");
+    }
+    EXPECT_EQ(connector.Clients(), 6);
+    std::remove(SocketPath);
+}
+
+TEST(AppConnector, SnapshotAboveBacklog) {
+    boost::asio::io_service ioService;
+    MemberTable table;
+    for (uint16_t port = 1; port <= 50; ++port)
+        table.UpdateRecordIfNewer(MakeMember(port, MemberInfo::State::Alive, 0));
+
+    // The snapshot alone is several times the limit
+    AppConnector connector{ioService, table, SocketPath, 512};
+    connector.Start();
+
+    stream_protocol::socket client{ioService};
+    boost::asio::streambuf buffer;
+    Connect(ioService, client, "{}");
+
+    auto snapshot = ReadLine(ioService, client, buffer);
+    EXPECT_EQ(snapshot["type"], "snapshot");
+    EXPECT_EQ(snapshot["members"].size(), 50);
+    EXPECT_GT(snapshot.dump().size(), 512);
+
+    table.UpdateRecordIfNewer(MakeMember(51, MemberInfo::State::Alive, 0));
+    connector.Publish();
+    EXPECT_EQ(ReadLine(ioService, client, buffer)["member"]["addr"]["port"], 51);
+
+    EXPECT_EQ(connector.Clients(), 1);
+    std::remove(SocketPath);
+}
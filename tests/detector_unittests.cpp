@@ -0,0 +1,311 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include <detector.hpp>
+
+using namespace std::chrono_literals;
+
+// Detector with its own table, messages go through the real wire format
+struct Node {
+    MemberAddr Addr;
+    MemberTable Table;
+    GossipPacker Packer;
+    FailureDetector Detector;
+
+    Node(uint16_t port, const DetectorConfig& config)
+      : Addr{boost::asio::ip::address::from_string("127.0.0.1"), port}
+      , Table{}
+      , Packer{1400, WireVersion::V2}
+      , Detector{Addr, config, Packer}
+    {}
+};
+
+class Cluster {
+private:
+    std::vector<std::unique_ptr<Node>> nodes_;
+
+public:
+    FailureDetector::Clock::time_point Now;
+
+    Cluster(size_t size, const DetectorConfig& config = DetectorConfig{})
+      : nodes_{}
+      , Now{}
+    {
+        for (size_t i = 0; i < size; ++i)
+            nodes_.emplace_back(new Node{static_cast<uint16_t>(9000 + i), config});
+
+        // Everybody knows everybody
+        for (auto& node : nodes_) {
+            for (auto& other : nodes_)
+                node->Table.UpdateRecordIfNewer(other->Detector.Self());
+        }
+    }
+
+    Node& operator[](size_t i) {
+        return *nodes_[i];
+    }
+
+    // Delivers messages until nobody replies, `down` nodes drop everything
+    void Deliver(std::deque<Gossip> messages, const std::vector<size_t>& down = {}) {
+        std::vector<byte> bytes(2048);
+
+        while (!messages.empty()) {
+            Gossip message = messages.front();
+            messages.pop_front();
+
+            for (size_t i = 0; i < nodes_.size(); ++i) {
+                if (!(nodes_[i]->Addr == message.Dest.Addr))
+                    continue;
+                if (std::find(down.cbegin(), down.cend(), i) != down.cend())
+                    break;
+
+                byte* end = message.Write(bytes.data(), bytes.data() + bytes.size(), WireVersion::V2);
+                ASSERT_NE(end, nullptr);
+
+                GossipView view;
+                ASSERT_NE(view.Parse(bytes.data(), end), nullptr);
+                EXPECT_EQ(view.Type(), message.Type);
+
+                std::deque<Conflict> conflicts;
+                nodes_[i]->Table.Update(view, conflicts);
+                nodes_[i]->Detector.Handle(view, nodes_[i]->Table, Now, messages);
+            }
+        }
+    }
+
+    std::deque<Gossip> Tick(size_t i) {
+        std::deque<Gossip> out;
+        nodes_[i]->Detector.Tick(nodes_[i]->Table, Now, out);
+        return out;
+    }
+
+    MemberInfo::State StatusAt(size_t observer, size_t target) {
+        const Member* record = nodes_[observer]->Table.Find(nodes_[target].get()->Addr);
+        EXPECT_NE(record, nullptr);
+        return record->Info.Status;
+    }
+};
+
+TEST(FailureDetector, AckKeepsAlive) {
+    Cluster cluster{2};
+
+    auto pings = cluster.Tick(0);
+    ASSERT_EQ(pings.size(), 1);
+    EXPECT_EQ(pings.front().Type, MessageKind::Ping);
+    cluster.Deliver(pings);
+
+    cluster.Now += 1s;
+    cluster.Deliver(cluster.Tick(0));
+
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Alive);
+    EXPECT_EQ(cluster[0].Detector.Suspicions(), 0);
+}
+
+TEST(FailureDetector, IndirectAck) {
+    Cluster cluster{3};
+
+    // Direct path to node 1 is lost, node 2 reaches it
+    auto pings = cluster.Tick(0);
+    ASSERT_EQ(pings.size(), 1);
+    size_t target = pings.front().Dest.Addr == cluster[1].Addr ? 1 : 2;
+    size_t helper = 3 - target;
+    cluster.Deliver(pings, {target});
+
+    cluster.Now += 500ms;
+    auto requests = cluster.Tick(0);
+    ASSERT_EQ(requests.size(), 1);
+    EXPECT_EQ(requests.front().Type, MessageKind::PingReq);
+    EXPECT_EQ(requests.front().Target.Addr, cluster[target].Addr);
+    EXPECT_EQ(requests.front().Dest.Addr, cluster[helper].Addr);
+    cluster.Deliver(requests);
+
+    cluster.Now += 500ms;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, target), MemberInfo::State::Alive);
+}
+
+TEST(FailureDetector, SuspectThenDead) {
+    DetectorConfig config;
+    config.SuspicionMaxMult = 1;
+    Cluster cluster{2, config};
+
+    cluster.Deliver(cluster.Tick(0), {1});
+    cluster.Now += 500ms;
+    cluster.Deliver(cluster.Tick(0), {1});
+    cluster.Now += 500ms;
+    cluster.Tick(0);
+
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+    EXPECT_EQ(cluster[0].Detector.Suspicions(), 1);
+
+    // Suspicion timeout is 4 probe intervals for a small cluster.
+    // Node 0 didn't get acks, so its probes are slower but suspicions aren't
+    cluster.Now += 3s;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+
+    cluster.Now += 1s;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Dead);
+    EXPECT_EQ(cluster[0].Detector.Suspicions(), 0);
+}
+
+TEST(FailureDetector, ConfirmationsShortenSuspicion) {
+    Cluster cluster{2};
+
+    cluster.Deliver(cluster.Tick(0), {1});
+    cluster.Now += 1s;
+    cluster.Tick(0);
+    ASSERT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+
+    // No confirmations: 6 times the minimal timeout
+    cluster.Now += 4s;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+
+    // Other members suspect it on their own
+    Member suspect = *cluster[0].Table.Find(cluster[1].Addr);
+    EXPECT_EQ(suspect.Info.Suspector, cluster[0].Addr.Packed());
+    std::vector<byte> bytes(256);
+    for (uint16_t port = 1; port <= 3; ++port) {
+        Gossip gossip{};
+        gossip.Owner = Member{MemberAddr{boost::asio::ip::address::from_string("10.0.0.1"), port},
+                              MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}};
+        gossip.Dest = cluster[0].Detector.Self();
+        suspect.Info.Suspector = gossip.Owner.Addr.Packed();
+        gossip.Events.push_back(suspect);
+
+        byte* end = gossip.Write(bytes.data(), bytes.data() + bytes.size(), WireVersion::V2);
+        GossipView view;
+        ASSERT_NE(view.Parse(bytes.data(), end), nullptr);
+
+        std::deque<Gossip> out;
+        cluster[0].Detector.Handle(view, cluster[0].Table, cluster.Now, out);
+        EXPECT_TRUE(out.empty());
+    }
+
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Dead);
+}
+
+TEST(FailureDetector, RelayedSuspicionIsNotConfirmation) {
+    Cluster cluster{2};
+
+    cluster.Deliver(cluster.Tick(0), {1});
+    cluster.Now += 1s;
+    cluster.Tick(0);
+    ASSERT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+    cluster.Now += 4s;
+
+    // Several members forward node 0's own suspicion back to it
+    Member suspect = *cluster[0].Table.Find(cluster[1].Addr);
+    std::vector<byte> bytes(256);
+    for (uint16_t port = 1; port <= 3; ++port) {
+        Gossip gossip{};
+        gossip.Owner = Member{MemberAddr{boost::asio::ip::address::from_string("10.0.0.1"), port},
+                              MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}};
+        gossip.Dest = cluster[0].Detector.Self();
+        gossip.Events.push_back(suspect);
+
+        byte* end = gossip.Write(bytes.data(), bytes.data() + bytes.size(), WireVersion::V2);
+        GossipView view;
+        ASSERT_NE(view.Parse(bytes.data(), end), nullptr);
+        ASSERT_EQ(view.Events().begin()->Info.Suspector, cluster[0].Addr.Packed());
+
+        std::deque<Gossip> out;
+        cluster[0].Detector.Handle(view, cluster[0].Table, cluster.Now, out);
+    }
+
+    // Still the maximal timeout: 6 times the minimal one
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+
+    cluster.Now += 20s;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Dead);
+}
+
+TEST(FailureDetector, LocalHealth) {
+    Cluster cluster{2};
+
+    // Missed acks slow down own probes
+    cluster.Deliver(cluster.Tick(0), {1});
+    cluster.Now += 1s;
+    cluster.Deliver(cluster.Tick(0), {1});
+    EXPECT_EQ(cluster[0].Detector.HealthScore(), 1);
+
+    cluster.Now += 1s;
+    EXPECT_TRUE(cluster.Tick(0).empty());
+    cluster.Now += 1s;
+    auto pings = cluster.Tick(0);
+    EXPECT_EQ(pings.size(), 1);
+    EXPECT_EQ(cluster[0].Detector.HealthScore(), 2);
+
+    // Every ack restores it a bit
+    cluster.Deliver(pings);
+    cluster.Now += 3s;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster[0].Detector.HealthScore(), 1);
+}
+
+TEST(FailureDetector, Refutation) {
+    Cluster cluster{2};
+
+    cluster.Deliver(cluster.Tick(0), {1});
+    cluster.Now += 1s;
+    // Suspicion is piggybacked on the next ping, node 1 refutes it
+    auto pings = cluster.Tick(0);
+    ASSERT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Suspicious);
+    cluster.Deliver(pings);
+    EXPECT_EQ(cluster.StatusAt(1, 1), MemberInfo::State::Suspicious);
+    cluster.Deliver(cluster.Tick(1));
+    EXPECT_EQ(cluster[1].Detector.Self().Info.Incarnation, 1);
+
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Alive);
+    cluster.Tick(0);
+    EXPECT_EQ(cluster[0].Detector.Suspicions(), 0);
+
+    cluster.Now += 10s;
+    cluster.Tick(0);
+    EXPECT_EQ(cluster.StatusAt(0, 1), MemberInfo::State::Alive);
+}
+
+TEST(FailureDetector, RestoredIncarnation) {
+    Cluster cluster{2};
+
+    // Node 1 restarted, others still have the record of its previous run
+    cluster[1].Detector.Restore(4);
+    EXPECT_EQ(cluster[1].Detector.Self().Info.Incarnation, 5);
+
+    cluster.Deliver(cluster.Tick(1));
+    const Member* record = cluster[1].Table.Find(cluster[1].Addr);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->Info.Incarnation, 5);
+}
+
+TEST(MemberTable, ChangesSince) {
+    MemberTable table;
+    uint64_t version = table.Version();
+
+    Member member{MemberAddr{boost::asio::ip::address::from_string("10.0.0.1"), 1},
+                  MemberInfo{MemberInfo::State::Alive, 0, TimeStamp{0}}};
+    EXPECT_TRUE(table.UpdateRecordIfNewer(member));
+    EXPECT_FALSE(table.UpdateRecordIfNewer(member));
+
+    member.Info.Status = MemberInfo::State::Suspicious;
+    EXPECT_TRUE(table.UpdateRecordIfNewer(member));
+
+    std::vector<Member> changes;
+    EXPECT_TRUE(table.ChangesSince(version, changes));
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes.back(), member);
+    EXPECT_EQ(version, table.Version());
+
+    changes.clear();
+    EXPECT_TRUE(table.ChangesSince(version, changes));
+    EXPECT_TRUE(changes.empty());
+}
@@ -0,0 +1,30 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#ifndef TESTS_MEMBERS_HPP_
+#define TESTS_MEMBERS_HPP_
+
+#include <cstdint>
+
+#include <types.hpp>
+
+// Records for test tables, none of them has a timestamp
+inline Member MakeMember(const MemberAddr& addr, MemberInfo::State state = MemberInfo::State::Alive,
+                         uint32_t incarnation = 0) {
+    return Member{addr, MemberInfo{state, incarnation, TimeStamp{0}}};
+}
+
+// Member at 10.0.0.1:`port`
+inline Member MakeMember(uint16_t port, MemberInfo::State state = MemberInfo::State::Alive,
+                         uint32_t incarnation = 0) {
+    return MakeMember(MemberAddr{boost::asio::ip::address::from_string("10.0.0.1"), port}, state, incarnation);
+}
+
+// Alive members on ports 1..`size`, every one with incarnation equal to its port
+inline MemberTable MakeTable(uint16_t size) {
+    MemberTable table;
+    for (uint16_t port = 1; port <= size; ++port)
+        table.UpdateRecordIfNewer(MakeMember(port, MemberInfo::State::Alive, port));
+    return table;
+}
+
+#endif // TESTS_MEMBERS_HPP_
@@ -0,0 +1,92 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <metrics.hpp>
+
+TEST(MetricsRegistry, CountersSumThreads) {
+    MetricsRegistry registry;
+    auto& counter = registry.AddCounter("test_events");
+
+    const size_t threads = 4;
+    const size_t events = 10000;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&counter] {
+            for (size_t j = 0; j < events; ++j)
+                counter.Add();
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    EXPECT_EQ(counter.Value(), threads * events);
+    EXPECT_NE(registry.Snapshot().find("test_events 40000\n"), std::string::npos);
+}
+
+TEST(MetricsRegistry, HistogramBuckets) {
+    MetricsRegistry registry;
+    auto& histogram = registry.AddHistogram("test_latency_us");
+
+    histogram.Record(std::chrono::nanoseconds{500});
+    histogram.Record(std::chrono::microseconds{1});
+    histogram.Record(std::chrono::microseconds{2});
+    histogram.Record(std::chrono::microseconds{3});
+    histogram.Record(std::chrono::microseconds{4});
+    histogram.Record(std::chrono::microseconds{5});
+    histogram.Record(std::chrono::seconds{100});
+
+    // `le` is inclusive, exact powers of two stay in their bucket
+    EXPECT_EQ(histogram.Bucket(0), 2);
+    EXPECT_EQ(histogram.Bucket(1), 1);
+    EXPECT_EQ(histogram.Bucket(2), 2);
+    EXPECT_EQ(histogram.Bucket(3), 1);
+    EXPECT_EQ(histogram.Bucket(MetricsRegistry::Histogram::BucketsCount - 1), 1);
+    EXPECT_EQ(histogram.Count(), 7);
+    EXPECT_EQ(histogram.Sum(), 100000015);
+
+    std::string snapshot = registry.Snapshot();
+    EXPECT_NE(snapshot.find("test_latency_us_bucket{le=\"1\"} 2\n"), std::string::npos);
+    EXPECT_NE(snapshot.find("test_latency_us_bucket{le=\"2\"} 3\n"), std::string::npos);
+    EXPECT_NE(snapshot.find("test_latency_us_bucket{le=\"4\"} 5\n"), std::string::npos);
+    EXPECT_NE(snapshot.find("test_latency_us_bucket{le=\"+Inf\"} 7\n"), std::string::npos);
+    EXPECT_NE(snapshot.find("test_latency_us_count 7\n"), std::string::npos);
+}
+
+TEST(MetricsServer, WritesSnapshot) {
+    using boost::asio::local::stream_protocol;
+
+    MetricsRegistry registry;
+    registry.AddCounter("test_events").Add(7);
+    registry.AddGauge("test_depth", [] { return 3; });
+
+    boost::asio::io_service ioService;
+    std::string path = "./metrics_unittests.sock";
+    MetricsServer server{ioService, registry, path};
+    server.Start();
+
+    std::thread serving{[&ioService] { ioService.run(); }};
+
+    stream_protocol::socket client{ioService};
+    client.connect(stream_protocol::endpoint{path});
+
+    std::string snapshot;
+    boost::system::error_code error;
+    char buffer[256];
+    while (!error) {
+        size_t read = client.read_some(boost::asio::buffer(buffer), error);
+        snapshot.append(buffer, read);
+    }
+
+    ioService.stop();
+    serving.join();
+
+    EXPECT_EQ(snapshot, "test_events 7\ntest_depth 3\n");
+    std::remove(path.c_str());
+}
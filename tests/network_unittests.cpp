@@ -0,0 +1,113 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <boost/asio.hpp>
+
+#include <network.hpp>
+
+using boost::asio::ip::udp;
+
+TEST(DatagramBatch, ReceivesManyPerCall) {
+    boost::asio::io_service ioService;
+    udp::socket receiver{ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+    udp::socket sender{ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+
+    const size_t count = 8;
+    for (size_t i = 0; i < count; ++i) {
+        std::string payload = "datagram " + std::to_string(i);
+        sender.send_to(boost::asio::buffer(payload), receiver.local_endpoint());
+    }
+
+    DatagramBatch batch{16, 64};
+    size_t received = 0;
+    while (received < count) {
+        received += batch.Receive(receiver.native_handle());
+    }
+
+    EXPECT_EQ(received, count);
+    EXPECT_LE(batch.TotalCalls(), count);
+    EXPECT_EQ(batch.Sender(0), sender.local_endpoint());
+
+    std::string last{batch.Begin(batch.Size() - 1), batch.End(batch.Size() - 1)};
+    EXPECT_EQ(last, "datagram " + std::to_string(count - 1));
+}
+
+TEST(DatagramBatch, MarksTruncated) {
+    boost::asio::io_service ioService;
+    udp::socket receiver{ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+    udp::socket sender{ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+
+    std::string payload(100, 'x');
+    sender.send_to(boost::asio::buffer(payload), receiver.local_endpoint());
+
+    DatagramBatch batch{4, 32};
+    ASSERT_EQ(batch.Receive(receiver.native_handle()), 1);
+
+    EXPECT_TRUE(batch.Truncated(0));
+    EXPECT_EQ(batch.End(0) - batch.Begin(0), 32);
+}
+
+TEST(DatagramSender, FlushesAllDatagrams) {
+    boost::asio::io_service ioService;
+    udp::socket receiver{ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+    udp::socket sender{ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0}};
+
+    DatagramSender batchSender{4096};
+    // Equal sizes to the same destination are candidates for GSO
+    const size_t count = 10;
+    for (size_t i = 0; i < count; ++i) {
+        std::string payload = "payload-" + std::to_string(i);
+        std::copy(payload.cbegin(), payload.cend(), batchSender.Begin());
+        batchSender.Commit(payload.size(), receiver.local_endpoint());
+    }
+    // Shorter tail segment
+    batchSender.Begin()[0] = 'x';
+    batchSender.Commit(1, receiver.local_endpoint());
+
+    EXPECT_EQ(batchSender.PendingCount(), count + 1);
+    batchSender.Flush(sender.native_handle());
+    EXPECT_EQ(batchSender.PendingCount(), 0);
+    EXPECT_EQ(batchSender.TotalDatagrams(), count + 1);
+
+    DatagramBatch batch{32, 64};
+    std::vector<std::string> received;
+    while (received.size() < count + 1) {
+        size_t size = batch.Receive(receiver.native_handle());
+        for (size_t i = 0; i < size; ++i)
+            received.emplace_back(batch.Begin(i), batch.End(i));
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        EXPECT_EQ(received[i], "payload-" + std::to_string(i));
+    EXPECT_EQ(received.back(), "x");
+}
+
+TEST(BindUDP, ReusePortShares) {
+    boost::asio::io_service ioService;
+    auto first = BindUDP(ioService, 0, true);
+    uint16_t port = first.local_endpoint().port();
+    auto second = BindUDP(ioService, port, true);
+    EXPECT_EQ(second.local_endpoint().port(), port);
+
+    // Senders are spread by their addresses, every one lands somewhere
+    const size_t count = 32;
+    std::vector<udp::socket> senders;
+    for (size_t i = 0; i < count; ++i) {
+        senders.emplace_back(ioService, udp::endpoint{boost::asio::ip::address_v4::loopback(), 0});
+        senders.back().send_to(boost::asio::buffer("x", 1),
+                               udp::endpoint{boost::asio::ip::address_v4::loopback(), port});
+    }
+
+    size_t received = 0;
+    DatagramBatch batch{count, 16};
+    for (auto* sock : {&first, &second}) {
+        sock->non_blocking(true);
+        while (sock->available() > 0)
+            received += batch.Receive(sock->native_handle());
+    }
+
+    EXPECT_EQ(received, count);
+}
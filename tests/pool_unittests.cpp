@@ -0,0 +1,96 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <behavior.hpp>
+
+#include "members.hpp"
+
+TEST(BufferPool, RecyclesSlots) {
+    BufferPool pool{64, 2};
+    const byte* first = nullptr;
+    {
+        ByteBuffer a = pool.Acquire();
+        ByteBuffer b = pool.Acquire();
+        ASSERT_FALSE(a.Empty());
+        ASSERT_FALSE(b.Empty());
+        EXPECT_EQ(a.Size(), 64);
+        EXPECT_NE(a.Begin(), b.Begin());
+        first = a.Begin();
+
+        EXPECT_TRUE(pool.Acquire().Empty());
+        EXPECT_EQ(pool.Exhausted(), 1);
+        EXPECT_EQ(pool.Available(), 0);
+
+        // Moving keeps the slot
+        ByteBuffer moved{std::move(a)};
+        EXPECT_TRUE(a.Empty());
+        EXPECT_EQ(moved.Begin(), first);
+        moved.Shrink(10);
+        EXPECT_EQ(moved.End() - moved.Begin(), 10);
+    }
+    EXPECT_EQ(pool.Available(), 2);
+
+    // The last returned slot is taken first
+    ByteBuffer again = pool.Acquire();
+    ByteBuffer last = pool.Acquire();
+    EXPECT_EQ(again.Size(), 64);
+    EXPECT_EQ(last.Begin(), first);
+    EXPECT_TRUE(pool.Acquire().Empty());
+}
+
+TEST(BufferPool, SharedBetweenThreads) {
+    const size_t threadsCount = 4;
+    BufferPool pool{256, threadsCount * 2};
+    std::atomic<bool> broken{false};
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadsCount; ++t) {
+        threads.emplace_back([&pool, &broken, t] {
+            for (size_t i = 0; i < 50000; ++i) {
+                ByteBuffer buffer = pool.Acquire();
+                if (buffer.Empty())
+                    continue;
+
+                // Nobody else may hold the slot meanwhile
+                std::fill(buffer.Begin(), buffer.End(), static_cast<byte>(t));
+                for (const byte* it = buffer.Begin(); it != buffer.End(); ++it) {
+                    if (*it != static_cast<byte>(t))
+                        broken = true;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_FALSE(broken);
+    EXPECT_EQ(pool.Available(), pool.Capacity());
+}
+
+TEST(GossipBatch, KeepsStorage) {
+    MemberTable table = MakeTable(32);
+    GossipPacker packer{1400, WireVersion::V2};
+    packer.Sync(table);
+
+    GossipBatch batch;
+    packer.Pack(batch.Next(), 3, MakeMember(1, MemberInfo::State::Alive, 1),
+                MakeMember(2, MemberInfo::State::Alive, 2), table);
+    ASSERT_EQ(batch.Size(), 1);
+    const Gossip& packed = *batch.begin();
+    EXPECT_NE(packed.Events.size(), 0);
+    size_t capacity = packed.Events.capacity();
+
+    batch.Clear();
+    EXPECT_TRUE(batch.Empty());
+    Gossip& reset = batch.Next();
+    EXPECT_EQ(&reset, &packed);
+    EXPECT_EQ(reset.TTL, 0);
+    EXPECT_EQ(reset.Events.size(), 0);
+    EXPECT_EQ(reset.Events.capacity(), capacity);
+    EXPECT_EQ(reset.Table.Size(), 0);
+}
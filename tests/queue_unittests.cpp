@@ -0,0 +1,95 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include <queue.hpp>
+
+TEST(MPSCQueue, DropsWhenFull) {
+    MPSCQueue<int> queue{4};
+    EXPECT_EQ(queue.Capacity(), 4);
+
+    for (int i = 0; i < 4; ++i)
+        EXPECT_TRUE(queue.Push(int{i}));
+    EXPECT_FALSE(queue.Push(42));
+    EXPECT_EQ(queue.Drops(), 1);
+    EXPECT_EQ(queue.Depth(), 4);
+
+    std::deque<int> bucket;
+    EXPECT_EQ(queue.Drain(bucket), 4);
+    EXPECT_EQ(bucket, (std::deque<int>{0, 1, 2, 3}));
+    EXPECT_EQ(queue.Depth(), 0);
+
+    // Freed cells are reusable
+    EXPECT_TRUE(queue.Push(5));
+    bucket.clear();
+    EXPECT_EQ(queue.Drain(bucket), 1);
+    EXPECT_EQ(bucket.front(), 5);
+}
+
+TEST(MPSCQueue, DrainIsBounded) {
+    MPSCQueue<int> queue{4};
+    for (int i = 0; i < 4; ++i)
+        queue.Push(int{i});
+
+    // A producer publishing a new value for every drained one
+    struct Refilling {
+        MPSCQueue<int>& Queue;
+        std::vector<int> Values;
+
+        void push_back(int value) {
+            Values.push_back(value);
+            Queue.Push(value + 4);
+        }
+    } bucket{queue, {}};
+
+    EXPECT_EQ(queue.Drain(bucket), queue.Capacity());
+    EXPECT_EQ(bucket.Values, (std::vector<int>{0, 1, 2, 3}));
+    // Refills are left for the next call
+    EXPECT_GT(queue.Depth(), 0);
+}
+
+TEST(MPSCQueue, ManyProducers) {
+    const size_t producersCount = 4;
+    const size_t perProducer = 100000;
+    MPSCQueue<size_t> queue{1024};
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < producersCount; ++p) {
+        producers.emplace_back([&queue, p, perProducer] {
+            for (size_t i = 0; i < perProducer; ++i) {
+                // Spins instead of dropping to check that nothing is lost
+                while (!queue.Push(p*perProducer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<size_t> lastSeen(producersCount, 0);
+    std::vector<size_t> counts(producersCount, 0);
+    size_t total = 0;
+    std::deque<size_t> bucket;
+    while (total < producersCount*perProducer) {
+        bucket.clear();
+        total += queue.Drain(bucket);
+        for (auto value : bucket) {
+            size_t producer = value / perProducer;
+            // Values of one producer keep their order
+            if (counts[producer] != 0) {
+                EXPECT_GT(value, lastSeen[producer]);
+            }
+            lastSeen[producer] = value;
+            ++counts[producer];
+        }
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    for (auto count : counts)
+        EXPECT_EQ(count, perProducer);
+}
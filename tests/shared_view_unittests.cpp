@@ -0,0 +1,148 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include <shared_writer.hpp>
+
+#include "members.hpp"
+
+namespace {
+
+const char* ViewPath = "./shared_view_unittests.shm";
+
+} // namespace
+
+TEST(SharedView, ReadsPublishedTable) {
+    SharedViewWriter writer{ViewPath, 16};
+    SharedViewReader reader{ViewPath};
+
+    MemberTable table;
+    table.UpdateRecordIfNewer(MakeMember(1, MemberInfo::State::Alive, 0));
+    table.UpdateRecordIfNewer(MakeMember(2, MemberInfo::State::Dead, 3));
+    EXPECT_TRUE(writer.Publish(table));
+    EXPECT_FALSE(writer.Publish(table));
+    EXPECT_EQ(reader.Version(), table.Version());
+
+    std::vector<SharedMemberRecord> members;
+    uint64_t version = 0;
+    ASSERT_TRUE(reader.Read(members, version));
+    EXPECT_EQ(version, table.Version());
+    ASSERT_EQ(members.size(), 1);
+    EXPECT_EQ(members[0].Family, 4);
+    EXPECT_EQ(members[0].Address[0], 10);
+    EXPECT_EQ(members[0].Address[3], 1);
+    EXPECT_EQ(members[0].Port, 1);
+
+    ASSERT_TRUE(reader.Read(members, version, false));
+    ASSERT_EQ(members.size(), 2);
+    EXPECT_EQ(members[1].Status, SharedMemberRecord::Dead);
+    EXPECT_EQ(members[1].Incarnation, 3);
+
+    std::remove(ViewPath);
+}
+
+TEST(SharedView, CapacityLimitsRecords) {
+    SharedViewWriter writer{ViewPath, 2};
+    SharedViewReader reader{ViewPath};
+
+    MemberTable table;
+    for (uint16_t port = 1; port <= 5; ++port)
+        table.UpdateRecordIfNewer(MakeMember(port, MemberInfo::State::Alive, 0));
+    writer.Publish(table);
+
+    std::vector<SharedMemberRecord> members;
+    uint64_t version = 0;
+    ASSERT_TRUE(reader.Read(members, version));
+    EXPECT_EQ(members.size(), 2);
+    EXPECT_EQ(reader.Total(), 5);
+
+    std::remove(ViewPath);
+}
+
+// A restarted daemon with another capacity must not resize the file
+// under readers that still have it mapped
+TEST(SharedView, RestartWithOtherCapacity) {
+    MemberTable table;
+    for (uint16_t port = 1; port <= 8; ++port)
+        table.UpdateRecordIfNewer(MakeMember(port, MemberInfo::State::Alive, 0));
+
+    std::vector<SharedMemberRecord> members;
+    uint64_t version = 0;
+    for (uint32_t capacity : {32u, 4u}) {
+        std::unique_ptr<SharedViewWriter> writer{new SharedViewWriter{ViewPath, 16}};
+        writer->Publish(table);
+        SharedViewReader reader{ViewPath};
+
+        writer.reset(new SharedViewWriter{ViewPath, capacity});
+        writer->Publish(table);
+        EXPECT_FALSE(reader.Read(members, version));
+
+        SharedViewReader reopened{ViewPath};
+        ASSERT_TRUE(reopened.Read(members, version));
+        EXPECT_EQ(members.size(), std::min<size_t>(capacity, 8));
+    }
+
+    // The same capacity keeps the file, so readers keep reading
+    SharedViewWriter writer{ViewPath, 4};
+    SharedViewReader reader{ViewPath};
+    SharedViewWriter restarted{ViewPath, 4};
+    restarted.Publish(table);
+    ASSERT_TRUE(reader.Read(members, version));
+    EXPECT_EQ(members.size(), 4);
+
+    std::remove(ViewPath);
+}
+
+TEST(SharedView, RejectsForeignFile) {
+    std::FILE* file = std::fopen(ViewPath, "w");
+    std::fputs(std::string(512, 'x').c_str(), file);
+    std::fclose(file);
+
+    EXPECT_THROW(SharedViewReader{ViewPath}, std::runtime_error);
+    EXPECT_THROW(SharedViewReader{"./missing.shm"}, std::runtime_error);
+
+    std::remove(ViewPath);
+}
+
+// Every publish bumps incarnations of all members at once, so a torn
+// read would show different incarnations
+TEST(SharedView, ReadsAreNeverTorn) {
+    const uint16_t membersCount = 512;
+
+    SharedViewWriter writer{ViewPath, membersCount};
+    SharedViewReader reader{ViewPath};
+
+    std::atomic<bool> done{false};
+    std::thread publisher{[&] {
+        MemberTable table;
+        for (uint32_t incarnation = 0; incarnation < 2000; ++incarnation) {
+            for (uint16_t port = 0; port < membersCount; ++port)
+                table.UpdateRecordIfNewer(MakeMember(port, MemberInfo::State::Alive, incarnation));
+            writer.Publish(table);
+        }
+        done = true;
+    }};
+
+    std::vector<SharedMemberRecord> members;
+    uint64_t version = 0;
+    size_t reads = 0;
+    while (!done) {
+        ASSERT_TRUE(reader.Read(members, version));
+        ++reads;
+        if (members.size() < membersCount)
+            continue;
+
+        for (const auto& member : members)
+            ASSERT_EQ(member.Incarnation, members.front().Incarnation);
+    }
+    publisher.join();
+
+    EXPECT_GT(reads, 0);
+    std::remove(ViewPath);
+}
@@ -0,0 +1,73 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include <simulator.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+SimulationConfig SmallCluster() {
+    SimulationConfig config;
+    config.Nodes = 32;
+    config.Duration = 20s;
+    config.Crashes = 2;
+    config.CrashAt = 5s;
+    config.Detector.SuspicionMaxMult = 1;
+    return config;
+}
+
+} // namespace
+
+TEST(Simulator, ConvergesAndDetects) {
+    SimulationReport report = Simulator{SmallCluster()}.Run();
+
+    EXPECT_GT(report.JoinConvergenceMs, 0);
+    EXPECT_LT(report.JoinConvergenceMs, 5000);
+    EXPECT_GT(report.FailureConvergenceMs, 0);
+    EXPECT_GT(report.BytesPerNodePerSecond, 0);
+    EXPECT_EQ(report.FalseDeaths, 0);
+}
+
+TEST(Simulator, Reproducible) {
+    auto config = SmallCluster();
+    config.Loss = 0.1;
+
+    auto first = Simulator{config}.Run().ToJSON();
+    auto second = Simulator{config}.Run().ToJSON();
+    EXPECT_EQ(first, second);
+
+    config.Seed = 2;
+    EXPECT_NE(Simulator{config}.Run().ToJSON(), first);
+}
+
+TEST(Simulator, PartitionCausesSuspicions) {
+    auto config = SmallCluster();
+    config.Crashes = 0;
+    config.PartitionSize = 16;
+    config.PartitionFrom = 5s;
+    config.PartitionTo = 10s;
+
+    SimulationReport report = Simulator{config}.Run();
+    EXPECT_GT(report.JoinConvergenceMs, 0);
+    EXPECT_LT(report.JoinConvergenceMs, 5000);
+    EXPECT_GT(report.Lost, 0);
+    EXPECT_GT(report.FalseSuspicions, 0);
+}
+
+TEST(Simulator, RejectsInvalidConfig) {
+    auto config = SmallCluster();
+    config.ProtocolPeriod = 0ms;
+    EXPECT_THROW(Simulator{config}, std::invalid_argument);
+
+    config = SmallCluster();
+    config.Loss = -0.1;
+    EXPECT_THROW(Simulator{config}, std::invalid_argument);
+    config.Loss = 1.5;
+    EXPECT_THROW(Simulator{config}, std::invalid_argument);
+    config.Loss = 1.0;
+    EXPECT_NO_THROW(Simulator{config});
+}
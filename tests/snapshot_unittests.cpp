@@ -0,0 +1,179 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <snapshot.hpp>
+
+#include "members.hpp"
+
+namespace {
+
+const char* SnapshotPath = "./snapshot_unittests.snapshot";
+
+// Flips a byte of the second record of `slot`
+void Corrupt(size_t capacity, int slot) {
+    std::fstream file{SnapshotPath, std::ios::in | std::ios::out | std::ios::binary};
+    file.seekp(64 + 2 * 64 + (slot * capacity + 1) * sizeof(SharedMemberRecord));
+    file.put(0x7f);
+}
+
+} // namespace
+
+TEST(TableSnapshot, RestoresTableAndIncarnation) {
+    std::remove(SnapshotPath);
+    MemberTable table = MakeTable(10);
+    table.UpdateRecordIfNewer(MakeMember(11, MemberInfo::State::Dead, 4));
+    {
+        TableSnapshot snapshot{SnapshotPath, 16};
+        uint32_t incarnation = 0;
+        MemberTable empty;
+        EXPECT_FALSE(snapshot.Load(empty, incarnation));
+
+        EXPECT_TRUE(snapshot.Save(table, 7));
+        EXPECT_FALSE(snapshot.Save(table, 7));
+        EXPECT_TRUE(snapshot.Save(table, 8));
+    }
+
+    TableSnapshot snapshot{SnapshotPath};
+    MemberTable restored;
+    uint32_t incarnation = 0;
+    ASSERT_TRUE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(incarnation, 8);
+    EXPECT_EQ(snapshot.Generation(), 2);
+    ASSERT_EQ(restored.Size(), table.Size());
+    EXPECT_TRUE(restored == table);
+
+    std::remove(SnapshotPath);
+}
+
+TEST(TableSnapshot, TornSaveFallsBackToPrevious) {
+    std::remove(SnapshotPath);
+    {
+        TableSnapshot snapshot{SnapshotPath, 16};
+        snapshot.Save(MakeTable(3), 1);
+        snapshot.Save(MakeTable(5), 2);
+    }
+    // The second save went to slot 1
+    Corrupt(16, 1);
+
+    TableSnapshot snapshot{SnapshotPath};
+    MemberTable restored;
+    uint32_t incarnation = 0;
+    ASSERT_TRUE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(incarnation, 1);
+    EXPECT_EQ(restored.Size(), 3);
+
+    // The next save overwrites the torn slot, not the valid one
+    snapshot.Save(MakeTable(4), 3);
+    Corrupt(16, 0);
+    MemberTable latest;
+    ASSERT_TRUE(snapshot.Load(latest, incarnation));
+    EXPECT_EQ(incarnation, 3);
+    EXPECT_EQ(latest.Size(), 4);
+
+    std::remove(SnapshotPath);
+}
+
+TEST(TableSnapshot, GrowsBeyondCapacity) {
+    std::remove(SnapshotPath);
+    MemberTable table = MakeTable(100);
+    {
+        TableSnapshot snapshot{SnapshotPath, 4};
+        snapshot.Save(MakeTable(2), 1);
+        EXPECT_TRUE(snapshot.Save(table, 2));
+    }
+
+    // The grown file took the place of the old one
+    EXPECT_FALSE(std::ifstream{std::string{SnapshotPath} + ".grow"}.good());
+
+    TableSnapshot snapshot{SnapshotPath, 4};
+    MemberTable restored;
+    uint32_t incarnation = 0;
+    ASSERT_TRUE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(incarnation, 2);
+    EXPECT_TRUE(restored == table);
+
+    std::remove(SnapshotPath);
+}
+
+TEST(TableSnapshot, CrashWhileGrowingKeepsPrevious) {
+    std::remove(SnapshotPath);
+    {
+        TableSnapshot snapshot{SnapshotPath, 4};
+        snapshot.Save(MakeTable(3), 1);
+    }
+    // A grown file left half-written by a crash
+    {
+        std::ofstream grown{std::string{SnapshotPath} + ".grow", std::ios::binary | std::ios::trunc};
+        grown << std::string(512, '\0');
+    }
+
+    TableSnapshot snapshot{SnapshotPath};
+    MemberTable restored;
+    uint32_t incarnation = 0;
+    ASSERT_TRUE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(incarnation, 1);
+    EXPECT_EQ(restored.Size(), 3);
+
+    // The next growth overwrites the leftover
+    EXPECT_TRUE(snapshot.Save(MakeTable(10), 2));
+    MemberTable latest;
+    ASSERT_TRUE(snapshot.Load(latest, incarnation));
+    EXPECT_EQ(incarnation, 2);
+    EXPECT_EQ(latest.Size(), 10);
+
+    std::remove(SnapshotPath);
+}
+
+TEST(TableSnapshot, FailedGrowthKeepsPrevious) {
+    std::remove(SnapshotPath);
+    std::string grown = std::string{SnapshotPath} + ".grow";
+    TableSnapshot snapshot{SnapshotPath, 4};
+    snapshot.Save(MakeTable(3), 1);
+
+    // Nothing can be created in place of the grown file
+    ASSERT_EQ(::mkdir(grown.c_str(), 0755), 0);
+    EXPECT_THROW(snapshot.Save(MakeTable(10), 2), std::runtime_error);
+
+    MemberTable restored;
+    uint32_t incarnation = 0;
+    ASSERT_TRUE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(incarnation, 1);
+    EXPECT_EQ(restored.Size(), 3);
+    EXPECT_TRUE(snapshot.Save(MakeTable(4), 2));
+
+    ::rmdir(grown.c_str());
+    EXPECT_TRUE(snapshot.Save(MakeTable(10), 3));
+    MemberTable latest;
+    ASSERT_TRUE(snapshot.Load(latest, incarnation));
+    EXPECT_EQ(incarnation, 3);
+    EXPECT_EQ(latest.Size(), 10);
+
+    std::remove(SnapshotPath);
+}
+
+TEST(TableSnapshot, IgnoresForeignFile) {
+    {
+        std::ofstream file{SnapshotPath, std::ios::binary | std::ios::trunc};
+        file << std::string(4096, 'x');
+    }
+
+    TableSnapshot snapshot{SnapshotPath, 8};
+    MemberTable restored;
+    uint32_t incarnation = 0;
+    EXPECT_FALSE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(restored.Size(), 0);
+
+    EXPECT_TRUE(snapshot.Save(MakeTable(3), 1));
+    ASSERT_TRUE(snapshot.Load(restored, incarnation));
+    EXPECT_EQ(restored.Size(), 3);
+
+    std::remove(SnapshotPath);
+}
@@ -0,0 +1,223 @@
+// Copyright 2019 AndreevSemen semen.andreev00@mail.ru
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+
+#include <sync.hpp>
+
+#include "members.hpp"
+
+namespace {
+
+MemberAddr Address(uint16_t port) {
+    return MemberAddr{boost::asio::ip::address::from_string("127.0.0.1"), port};
+}
+
+// Runs handlers until `done()` or a second passes
+bool RunUntil(boost::asio::io_service& ioService, const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{1};
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        ioService.run_for(std::chrono::milliseconds{5});
+        ioService.restart();
+    }
+
+    return done();
+}
+
+} // namespace
+
+TEST(PushPullSync, JoinGetsFullState) {
+    boost::asio::io_service ioService;
+
+    MemberTable seedTable;
+    for (uint16_t port = 20000; port < 20500; ++port)
+        seedTable.UpdateRecordIfNewer(MakeMember(Address(port)));
+    seedTable.UpdateRecordIfNewer(MakeMember(Address(20600), MemberInfo::State::Dead, 2));
+
+    MemberTable newTable;
+    newTable.UpdateRecordIfNewer(MakeMember(Address(18102)));
+
+    SyncConfig config;
+    config.Interval = std::chrono::milliseconds{0};
+    PushPullSync seed{ioService, seedTable, Address(18101), config};
+    PushPullSync newcomer{ioService, newTable, Address(18102), config};
+    seed.Start();
+    newcomer.Start();
+
+    // Unreachable seeds are skipped
+    newcomer.Join({Address(18102), Address(18109), Address(18101)});
+    ASSERT_TRUE(RunUntil(ioService, [&] { return newcomer.Completed() == 1 && seed.Completed() == 1; }));
+
+    // Both sides got everything, the owners' records too
+    EXPECT_EQ(newTable.Size(), 503);
+    EXPECT_EQ(seedTable.Size(), 502);
+    ASSERT_NE(newTable.Find(Address(20600)), nullptr);
+    EXPECT_EQ(newTable.Find(Address(20600))->Info.Status, MemberInfo::State::Dead);
+    ASSERT_NE(seedTable.Find(Address(18102)), nullptr);
+    ASSERT_NE(newTable.Find(Address(18101)), nullptr);
+    EXPECT_EQ(newcomer.Failed(), 0);
+}
+
+TEST(PushPullSync, NewerRecordsWin) {
+    boost::asio::io_service ioService;
+
+    MemberTable first;
+    first.UpdateRecordIfNewer(MakeMember(Address(20000), MemberInfo::State::Suspicious, 3));
+    first.UpdateRecordIfNewer(MakeMember(Address(20001), MemberInfo::State::Alive, 1));
+
+    MemberTable second;
+    second.UpdateRecordIfNewer(MakeMember(Address(20000), MemberInfo::State::Alive, 4));
+    second.UpdateRecordIfNewer(MakeMember(Address(20001), MemberInfo::State::Dead, 1));
+
+    SyncConfig config;
+    config.Interval = std::chrono::milliseconds{0};
+    PushPullSync firstSync{ioService, first, Address(18111), config};
+    PushPullSync secondSync{ioService, second, Address(18112), config};
+    firstSync.Start();
+    secondSync.Start();
+
+    EXPECT_TRUE(firstSync.Exchange(Address(18112)));
+    // One outgoing exchange at a time
+    EXPECT_FALSE(firstSync.Exchange(Address(18112)));
+    ASSERT_TRUE(RunUntil(ioService, [&] { return firstSync.Completed() == 1 && secondSync.Completed() == 1; }));
+
+    for (const MemberTable* table : {&first, &second}) {
+        EXPECT_EQ(table->Find(Address(20000))->Info.Incarnation, 4);
+        EXPECT_EQ(table->Find(Address(20000))->Info.Status, MemberInfo::State::Alive);
+        EXPECT_EQ(table->Find(Address(20001))->Info.Status, MemberInfo::State::Dead);
+    }
+}
+
+TEST(PushPullSync, RefusesOversizedState) {
+    boost::asio::io_service ioService;
+
+    MemberTable big;
+    for (uint16_t port = 20000; port < 20100; ++port)
+        big.UpdateRecordIfNewer(MakeMember(Address(port)));
+    MemberTable small;
+
+    SyncConfig config;
+    config.Interval = std::chrono::milliseconds{0};
+    config.MaxStateSize = 1024;
+    PushPullSync bigSync{ioService, big, Address(18121), config};
+    PushPullSync smallSync{ioService, small, Address(18122), config};
+    bigSync.Start();
+    smallSync.Start();
+
+    bigSync.Exchange(Address(18122));
+    ASSERT_TRUE(RunUntil(ioService, [&] { return bigSync.Failed() == 1 && smallSync.Failed() == 1; }));
+    EXPECT_EQ(small.Size(), 0);
+}
+
+TEST(PushPullSync, PeriodicExchange) {
+    boost::asio::io_service ioService;
+
+    MemberTable first;
+    first.UpdateRecordIfNewer(MakeMember(Address(18131)));
+    MemberTable second;
+    second.UpdateRecordIfNewer(MakeMember(Address(18132)));
+    second.UpdateRecordIfNewer(MakeMember(Address(18131)));
+    second.UpdateRecordIfNewer(MakeMember(Address(20000)));
+
+    SyncConfig config;
+    config.Interval = std::chrono::milliseconds{10};
+    PushPullSync firstSync{ioService, first, Address(18131), config};
+    PushPullSync secondSync{ioService, second, Address(18132), config};
+    firstSync.Start();
+    secondSync.Start();
+
+    // The second one is the only alive member the first could pick... once
+    // it knows it, which it learns from the second's exchanges
+    ASSERT_TRUE(RunUntil(ioService, [&] { return first.Size() == 3; }));
+    EXPECT_NE(first.Find(Address(20000)), nullptr);
+}
+
+TEST(PushPullSync, DigestsOfSyncedTables) {
+    boost::asio::io_service ioService;
+
+    MemberTable first;
+    MemberTable second;
+    // Different insertion orders
+    for (uint16_t port = 20000; port < 22000; ++port)
+        first.UpdateRecordIfNewer(MakeMember(Address(port)));
+    for (uint16_t port = 22000; port > 20000; --port)
+        second.UpdateRecordIfNewer(MakeMember(Address(port - 1)));
+    first.UpdateRecordIfNewer(MakeMember(Address(18141)));
+    second.UpdateRecordIfNewer(MakeMember(Address(18141)));
+
+    SyncConfig config;
+    config.Interval = std::chrono::milliseconds{0};
+    config.Digests = true;
+    PushPullSync firstSync{ioService, first, Address(18141), config};
+    PushPullSync secondSync{ioService, second, Address(18142), config};
+    firstSync.Start();
+    secondSync.Start();
+
+    firstSync.Exchange(Address(18142));
+    ASSERT_TRUE(RunUntil(ioService, [&] { return firstSync.Completed() == 1 && secondSync.Completed() == 1; }));
+
+    EXPECT_EQ(firstSync.Matched(), 1);
+    EXPECT_EQ(secondSync.Matched(), 1);
+    // Digest and the answer, headers included
+    EXPECT_LE(firstSync.BytesSent() + secondSync.BytesSent(), 32);
+}
+
+TEST(PushPullSync, DigestsRepairDivergedRanges) {
+    boost::asio::io_service ioService;
+
+    MemberTable first;
+    MemberTable second;
+    for (uint16_t port = 20000; port < 22000; ++port) {
+        first.UpdateRecordIfNewer(MakeMember(Address(port)));
+        second.UpdateRecordIfNewer(MakeMember(Address(port)));
+    }
+    first.UpdateRecordIfNewer(MakeMember(Address(20100), MemberInfo::State::Dead, 0));
+    second.UpdateRecordIfNewer(MakeMember(Address(20200), MemberInfo::State::Alive, 7));
+    second.UpdateRecordIfNewer(MakeMember(Address(23000)));
+
+    SyncConfig config;
+    config.Interval = std::chrono::milliseconds{0};
+    config.Digests = true;
+    PushPullSync firstSync{ioService, first, Address(18151), config};
+    PushPullSync secondSync{ioService, second, Address(18152), config};
+    firstSync.Start();
+    secondSync.Start();
+
+    firstSync.Exchange(Address(18152));
+    ASSERT_TRUE(RunUntil(ioService, [&] { return firstSync.Completed() == 1 && secondSync.Completed() == 1; }));
+    EXPECT_EQ(firstSync.Matched(), 0);
+
+    for (const MemberTable* table : {&first, &second}) {
+        EXPECT_EQ(table->Find(Address(20100))->Info.Status, MemberInfo::State::Dead);
+        EXPECT_EQ(table->Find(Address(20200))->Info.Incarnation, 7);
+        EXPECT_NE(table->Find(Address(23000)), nullptr);
+    }
+    // Owners' records are the only ones not diverged before
+    EXPECT_EQ(first.Size(), 2002);
+    EXPECT_EQ(second.Size(), 2002);
+
+    // Far less than both tables, 36 KB
+    EXPECT_LT(firstSync.BytesSent() + secondSync.BytesSent(), 4096);
+
+    // Now the tables agree
+    first.UpdateRecordIfNewer(MakeMember(Address(18151)));
+    second.UpdateRecordIfNewer(MakeMember(Address(18152)));
+    firstSync.Exchange(Address(18152));
+    ASSERT_TRUE(RunUntil(ioService, [&] { return firstSync.Completed() == 2; }));
+    EXPECT_EQ(first.Digest(), second.Digest());
+}
+
+TEST(PushPullSync, ParseSeeds) {
+    auto seeds = ParseSeeds("10.0.0.1:8005,127.0.0.1:1");
+    ASSERT_EQ(seeds.size(), 2);
+    EXPECT_EQ(seeds[0].IP.to_string(), "10.0.0.1");
+    EXPECT_EQ(seeds[0].Port, 8005);
+    EXPECT_EQ(seeds[1].Port, 1);
+
+    EXPECT_TRUE(ParseSeeds("").empty());
+    EXPECT_THROW(ParseSeeds("10.0.0.1"), std::invalid_argument);
+    EXPECT_THROW(ParseSeeds("10.0.0.1:70000"), std::invalid_argument);
+    EXPECT_THROW(ParseSeeds("host:8005"), std::invalid_argument);
+}
@@ -3,10 +3,13 @@
 #include <gtest/gtest.h>
 #include <arpa/inet.h>
 
+#include <cstring>
 #include <random>
 
 #include <types.hpp>
+#include <json_writer.hpp>
 #include <buffer.hpp>
+#include <packer.hpp>
 #include <boost/asio/ip/udp.hpp>
 
 
@@ -15,7 +18,7 @@ void MemberTable::DebugInsert(const Member& member) {
 }
 
 bool MemberTable::DebugIsExists(const Member& member) const {
-    return index_.find(member.Addr) != index_.end();
+    return index_.Find(member.Addr.Packed()) != nullptr;
 }
 
 class MemberList {
@@ -127,6 +130,45 @@ TEST(TypeTranslation, Member) {
     EXPECT_EQ(readPtr, nullptr);
 }
 
+TEST(TypeTranslation, Codec) {
+    static_assert(EncodedSize<MemberAddr> == sizeof(uint32_t) + sizeof(uint16_t), "v1 address");
+    static_assert(EncodedSize<MemberInfo> ==
+                  sizeof(MemberInfo::State) + sizeof(uint32_t) + sizeof(TimeStamp), "v1 info");
+    static_assert(EncodedSize<Member> == EncodedSize<MemberAddr> + EncodedSize<MemberInfo>, "v1 member");
+
+    // Fields go back to back in declaration order, host byte order
+    Member member{MemberAddr{boost::asio::ip::address_v4{0x0A000001u}, 8000},
+                  MemberInfo{MemberInfo::State::Dead, 7, TimeStamp{9}}};
+    std::vector<byte> buffer(EncodedSize<Member>);
+    ASSERT_EQ(WriteRecord(buffer.data(), buffer.data() + buffer.size(), member), buffer.data() + buffer.size());
+
+    uint32_t ip = 0;
+    uint16_t port = 0;
+    uint32_t incarnation = 0;
+    std::memcpy(&ip, buffer.data(), sizeof(ip));
+    std::memcpy(&port, buffer.data() + 4, sizeof(port));
+    std::memcpy(&incarnation, buffer.data() + 6 + sizeof(MemberInfo::State), sizeof(incarnation));
+    EXPECT_EQ(ip, 0x0A000001u);
+    EXPECT_EQ(port, 8000);
+    EXPECT_EQ(incarnation, 7);
+
+    // Arrays are checked as a whole
+    std::vector<Member> members(3, member);
+    std::vector<byte> records(3*EncodedSize<Member> - 1);
+    EXPECT_EQ(WriteRecords(records.data(), records.data() + records.size(), members.begin(), 3), nullptr);
+    records.resize(3*EncodedSize<Member>);
+    ASSERT_NE(WriteRecords(records.data(), records.data() + records.size(), members.begin(), 3), nullptr);
+
+    size_t count = 0;
+    EXPECT_EQ(ReadRecords<Member>(records.data(), records.data() + records.size(), 4,
+                                  [&count](const Member&) { ++count; }), nullptr);
+    EXPECT_EQ(count, 0);
+    EXPECT_EQ(ReadRecords<Member>(records.data(), records.data() + records.size(), 3,
+                                  [&](const Member& read) { EXPECT_EQ(read, member); ++count; }),
+              records.data() + records.size());
+    EXPECT_EQ(count, 3);
+}
+
 TEST(TypeTranslation, MemberTable) {
     // Normal buffer test
     MemberTable table;
@@ -192,6 +234,58 @@ TEST(TypeTranslation, Gossip) {
     EXPECT_EQ(readPtr, nullptr);
 }
 
+TEST(MemberTable, MergeBatch) {
+    auto make = [](uint16_t port, MemberInfo::State state, uint32_t incarnation) {
+        return Member{MemberAddr{boost::asio::ip::address::from_string("10.0.0.1"), port},
+                      MemberInfo{state, incarnation, TimeStamp{0}}};
+    };
+
+    MemberTable initial;
+    initial.UpdateRecordIfNewer(make(1, MemberInfo::State::Alive, 5));
+    initial.UpdateRecordIfNewer(make(2, MemberInfo::State::Alive, 1));
+
+    // Copies of the same news forwarded by different owners, one of them lagging
+    std::deque<Gossip> drain(3);
+    for (uint16_t i = 0; i < drain.size(); ++i) {
+        drain[i].Owner = make(10 + i, MemberInfo::State::Alive, 0);
+        drain[i].Events.push_back(make(2, MemberInfo::State::Suspicious, 1));
+        drain[i].Table.UpdateRecordIfNewer(make(3, MemberInfo::State::Alive, i));
+    }
+    drain[1].Table.UpdateRecordIfNewer(make(1, MemberInfo::State::Alive, 4));
+    drain[2].Table.UpdateRecordIfNewer(make(2, MemberInfo::State::Dead, 1));
+
+    MemberTable sequential = initial;
+    std::deque<Conflict> sequentialConflicts;
+    for (const auto& gossip : drain)
+        sequential.Update(gossip, sequentialConflicts);
+
+    MemberTable batched = initial;
+    std::deque<Conflict> conflicts;
+    MergeBatch batch;
+    for (const auto& gossip : drain)
+        batch.Add(batched, gossip, conflicts);
+
+    // 11 records, newer ones are about 3 owners and members 2 and 3
+    EXPECT_EQ(batch.Size(), 5);
+    EXPECT_EQ(batch.Coalesced(), 6);
+    uint64_t version = batched.Version();
+    EXPECT_EQ(batch.Apply(batched), 5);
+    EXPECT_EQ(batched.Version(), version + 5);
+
+    EXPECT_EQ(batched, sequential);
+    EXPECT_EQ(batched.Find(make(2, MemberInfo::State::Dead, 1).Addr)->Info.Status, MemberInfo::State::Dead);
+    EXPECT_EQ(batched.Find(make(3, MemberInfo::State::Alive, 0).Addr)->Info.Incarnation, 2);
+
+    // Only the record staler than the table before the batch is a conflict
+    ASSERT_EQ(conflicts.size(), 1);
+    EXPECT_EQ(conflicts[0].Initiator, drain[1].Owner.Addr);
+    EXPECT_EQ(conflicts[0].Target, make(1, MemberInfo::State::Alive, 0).Addr);
+
+    batch.Clear();
+    EXPECT_EQ(batch.Size(), 0);
+    EXPECT_EQ(batch.Coalesced(), 0);
+}
+
 TEST(MemberTable, RandomMethods) {
     MemberTable table;
     for (const auto& member : list.GetList()) {
@@ -224,3 +318,435 @@ TEST(MemberTable, RandomMethods) {
 }
 
 
+
+TEST(TypeTranslation, GossipView) {
+    Gossip gossip;
+    gossip.TTL = 7;
+    gossip.Owner = list.RandomMember();
+    gossip.Dest = list.RandomMember();
+    gossip.Events = list.GetList();
+
+    for (const auto& member : list.GetList())
+        gossip.Table.DebugInsert(member);
+
+    ByteBuffer buffer{gossip.ByteSize()};
+    gossip.Write(buffer.Begin(), buffer.End());
+
+    GossipView view;
+    EXPECT_EQ(view.Parse(buffer.Begin(), buffer.End()), buffer.End());
+
+    EXPECT_EQ(view.TTL(), gossip.TTL);
+    EXPECT_EQ(view.Owner(), gossip.Owner);
+    EXPECT_EQ(view.Dest(), gossip.Dest);
+    EXPECT_EQ(std::vector<Member>(view.Events().begin(), view.Events().end()), gossip.Events);
+    EXPECT_EQ(view.Table().Size(), gossip.Table.Size());
+
+    // Merging from view and from decoded gossip gives the same table
+    MemberTable fromGossip;
+    MemberTable fromView;
+    std::deque<Conflict> conflicts;
+    fromGossip.Update(gossip, conflicts);
+    fromView.Update(view, conflicts);
+    EXPECT_EQ(fromView, fromGossip);
+    EXPECT_EQ(fromView.Size(), fromGossip.Size());
+
+    // Short buffer test
+    for (size_t size = 0; size < buffer.Size(); size += 7)
+        EXPECT_EQ(view.Parse(buffer.Begin(), buffer.Begin() + size), nullptr);
+}
+
+TEST(TypeTranslation, CorruptedStatus) {
+    Gossip gossip;
+    gossip.TTL = 7;
+    gossip.Owner = list.RandomMember();
+    gossip.Dest = list.RandomMember();
+    gossip.Events = list.GetList();
+    for (const auto& member : list.GetList())
+        gossip.Table.DebugInsert(member);
+
+    ByteBuffer buffer{gossip.ByteSize()};
+    gossip.Write(buffer.Begin(), buffer.End());
+
+    // Status follows the 6 B address of every record
+    const size_t status = EncodedSize<MemberAddr>;
+    const size_t events = sizeof(gossip.TTL) + 2*EncodedSize<Member> + sizeof(size_t);
+    const size_t table = events + gossip.Events.size()*EncodedSize<Member> + sizeof(size_t);
+    for (size_t offset : {sizeof(gossip.TTL) + status,
+                          events + 2*EncodedSize<Member> + status,
+                          table + (gossip.Table.Size() - 1)*EncodedSize<Member> + status}) {
+        for (byte value : {byte{4}, byte{0x80}}) {
+            std::vector<byte> corrupted(buffer.Begin(), buffer.End());
+            corrupted[offset] = value;
+
+            GossipView view;
+            EXPECT_EQ(view.Parse(corrupted.data(), corrupted.data() + corrupted.size()), nullptr);
+        }
+    }
+
+    // Direct reads of records and tables are checked too
+    std::vector<byte> record(EncodedSize<Member>);
+    gossip.Owner.Write(record.data(), record.data() + record.size());
+    record[status] = 4;
+    Member member{};
+    EXPECT_EQ(member.Read(record.data(), record.data() + record.size()), nullptr);
+
+    ByteBuffer tableBuffer{gossip.Table.ByteSize()};
+    gossip.Table.Write(tableBuffer.Begin(), tableBuffer.End());
+    tableBuffer.Begin()[sizeof(size_t) + EncodedSize<Member> + status] = 4;
+    MemberTable read;
+    EXPECT_EQ(read.Read(tableBuffer.Begin(), tableBuffer.End()), nullptr);
+    EXPECT_EQ(read.Size(), 0);
+}
+
+TEST(TypeTranslation, Varint) {
+    for (uint64_t value : {uint64_t{0}, uint64_t{1}, uint64_t{127}, uint64_t{128},
+                           uint64_t{300}, uint64_t{UINT32_MAX}, uint64_t{UINT64_MAX}}) {
+        byte buffer[10];
+        auto writePtr = WriteVarint(buffer, buffer + sizeof(buffer), value);
+        ASSERT_NE(writePtr, nullptr);
+        EXPECT_EQ(writePtr - buffer, VarintSize(value));
+
+        uint64_t result = 0;
+        EXPECT_EQ(ReadVarint(buffer, writePtr, result), writePtr);
+        EXPECT_EQ(result, value);
+
+        EXPECT_EQ(ReadVarint(buffer, writePtr - 1, result), nullptr);
+    }
+
+    for (int64_t value : {int64_t{0}, int64_t{-1}, int64_t{1}, int64_t{INT32_MIN}, int64_t{INT32_MAX}})
+        EXPECT_EQ(ZigZagDecode(ZigZagEncode(value)), value);
+}
+
+TEST(TypeTranslation, GossipV2) {
+    Gossip gossip;
+    gossip.TTL = 300;
+    gossip.Owner = list.RandomMember();
+    gossip.Dest = list.RandomMember();
+    gossip.Events = list.GetList();
+
+    for (const auto& member : list.GetList())
+        gossip.Table.DebugInsert(member);
+
+    ByteBuffer buffer{gossip.ByteSize(WireVersion::V2)};
+    auto writePtr = gossip.Write(buffer.Begin(), buffer.End(), WireVersion::V2);
+    EXPECT_EQ(writePtr, buffer.End());
+    EXPECT_TRUE(IsWireV2(buffer.Begin(), buffer.End()));
+
+    // v1 and v2 are both readable by the same reader
+    Gossip result;
+    auto readPtr = result.Read(buffer.Begin(), buffer.End());
+    EXPECT_EQ(readPtr, buffer.End());
+    EXPECT_EQ(result, gossip);
+
+    GossipView view;
+    EXPECT_EQ(view.Parse(buffer.Begin(), buffer.End()), buffer.End());
+    EXPECT_EQ(view.Version(), WireVersion::V2);
+    EXPECT_EQ(view.TTL(), gossip.TTL);
+    EXPECT_EQ(std::vector<Member>(view.Events().begin(), view.Events().end()), gossip.Events);
+
+    // Timestamps survive too
+    for (size_t i = 0; i < gossip.Events.size(); ++i)
+        EXPECT_EQ(result.Events[i].Info.LastUpdate.Time, gossip.Events[i].Info.LastUpdate.Time);
+
+    // Short buffer test
+    ByteBuffer shortBuff{gossip.ByteSize(WireVersion::V2) - 1};
+    EXPECT_EQ(gossip.Write(shortBuff.Begin(), shortBuff.End(), WireVersion::V2), nullptr);
+    for (size_t size = 0; size < buffer.Size(); ++size) {
+        Gossip truncated;
+        EXPECT_EQ(truncated.Read(buffer.Begin(), buffer.Begin() + size), nullptr);
+    }
+}
+
+TEST(TypeTranslation, GossipV2IsCompact) {
+    Gossip gossip;
+    gossip.Owner = list.RandomMember();
+    gossip.Dest = list.RandomMember();
+    for (const auto& member : list.GetList()) {
+        Member fresh{member};
+        fresh.Info.Incarnation = 1000 + fresh.Addr.Port;
+        fresh.Info.LastUpdate.Time = 0;
+        gossip.Table.DebugInsert(fresh);
+    }
+
+    EXPECT_LT(gossip.ByteSize(WireVersion::V2)*2, gossip.ByteSize(WireVersion::V1));
+}
+
+TEST(GossipPacker, NeverExceedsMTU) {
+    MemberTable table;
+    for (const auto& member : list.GetList())
+        table.DebugInsert(member);
+
+    for (auto version : {WireVersion::V1, WireVersion::V2}) {
+        for (size_t mtu : {64, 128, 300, 1400}) {
+            GossipPacker packer{mtu, version};
+            packer.Enqueue(list.GetList());
+
+            auto gossip = packer.Pack(3, list.RandomMember(), list.RandomMember(), table);
+            EXPECT_LE(gossip.ByteSize(version), mtu);
+
+            // Small datagram is filled close to the limit
+            EXPECT_GT(gossip.ByteSize(version) + 2*Member{}.ByteSize(), std::min<size_t>(mtu, table.ByteSize()));
+        }
+    }
+}
+
+TEST(GossipPacker, PiggybackPriority) {
+    MemberTable table;
+    GossipPacker packer{1400, WireVersion::V1, 1};
+
+    Member alive{list.GetList()[0]};
+    alive.Info.Status = MemberInfo::State::Alive;
+    Member dead{list.GetList()[1]};
+    dead.Info.Status = MemberInfo::State::Dead;
+    packer.Enqueue(alive);
+    packer.Enqueue(dead);
+
+    // Room for owner, dest and exactly one event
+    GossipPacker tight{2 + 2*Member{}.ByteSize() + 2*sizeof(size_t) + Member{}.ByteSize(), WireVersion::V1, 1};
+    tight.Enqueue(alive);
+    tight.Enqueue(dead);
+
+    auto first = tight.Pack(1, alive, dead, table);
+    ASSERT_EQ(first.Events.size(), 1);
+    EXPECT_EQ(first.Events[0], dead);
+
+    auto second = tight.Pack(1, alive, dead, table);
+    ASSERT_EQ(second.Events.size(), 1);
+    EXPECT_EQ(second.Events[0], alive);
+
+    // Both are retired after one transmission in a tiny cluster
+    EXPECT_EQ(tight.Pending(), 0);
+
+    // The same change coming back doesn't restart dissemination
+    packer.Enqueue(dead);
+    EXPECT_EQ(packer.Pending(), 2);
+    auto full = packer.Pack(1, alive, dead, table);
+    EXPECT_EQ(full.Events.size(), 2);
+    EXPECT_EQ(packer.Pending(), 0);
+}
+
+TEST(MemberIndex, InsertFindErase) {
+    MemberIndex index;
+    std::mt19937_64 generator{42};
+
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < 100000; ++i)
+        keys.push_back(generator() & 0xFFFFFFFFFFFFull);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+        index.Insert(keys[i], i);
+    EXPECT_LE(index.Size(), keys.size());
+    EXPECT_LE(index.Size()*8, index.Capacity()*7);
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto found = index.Find(keys[i]);
+        ASSERT_NE(found, nullptr);
+        EXPECT_EQ(keys[*found], keys[i]);
+    }
+
+    // Existing keys keep their values
+    EXPECT_FALSE(index.Insert(keys[0], 12345));
+    EXPECT_NE(*index.Find(keys[0]), 12345);
+
+    for (size_t i = 0; i < keys.size(); i += 2)
+        index.Erase(keys[i]);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2 == 0) {
+            EXPECT_EQ(index.Find(keys[i]), nullptr);
+        } else {
+            EXPECT_NE(index.Find(keys[i]), nullptr);
+        }
+    }
+
+    EXPECT_EQ(index.Find(0xFFFFFFFFFFFFFFFFull), nullptr);
+}
+
+TEST(MemberTable, Sample) {
+    MemberTable table;
+    for (const auto& member : list.GetList())
+        table.DebugInsert(member);
+
+    size_t aliveCount = 0;
+    for (const auto& member : list.GetList())
+        aliveCount += member.Info.Status == MemberInfo::State::Alive;
+
+    std::vector<Member> out(list.GetList().size() + 5);
+    for (size_t count : {size_t{1}, size_t{4}, list.GetList().size()/2, out.size()}) {
+        size_t taken = table.Sample(out.data(), count);
+        EXPECT_EQ(taken, std::min(count, table.Size()));
+
+        for (size_t i = 0; i < taken; ++i) {
+            EXPECT_TRUE(table.DebugIsExists(out[i]));
+            for (size_t j = 0; j < i; ++j)
+                EXPECT_FALSE(out[i].Addr == out[j].Addr);
+        }
+
+        taken = table.Sample(out.data(), count, MemberTable::OnlyStatus(MemberInfo::State::Alive));
+        EXPECT_EQ(taken, std::min(count, aliveCount));
+        for (size_t i = 0; i < taken; ++i)
+            EXPECT_EQ(out[i].Info.Status, MemberInfo::State::Alive);
+    }
+
+    // Every member is eventually picked
+    std::vector<size_t> hits(list.GetList().size(), 0);
+    for (size_t round = 0; round < 1000; ++round) {
+        size_t taken = table.Sample(out.data(), 2);
+        for (size_t i = 0; i < taken; ++i)
+            ++hits[out[i].Addr.Port - 80];
+    }
+    for (auto hit : hits)
+        EXPECT_GT(hit, 0);
+}
+
+TEST(MemberTable, NextProbeTarget) {
+    MemberTable table;
+    std::vector<Member> members = list.GetList();
+    for (auto& member : members) {
+        member.Info.Status = MemberInfo::State::Alive;
+    }
+    members[1].Info.Status = MemberInfo::State::Dead;
+    members[2].Info.Status = MemberInfo::State::Left;
+
+    for (size_t i = 0; i < members.size() - 1; ++i)
+        table.DebugInsert(members[i]);
+    const MemberAddr& self = members[0].Addr;
+
+    // Every eligible member is probed within 2 * N - 1 picks
+    std::vector<size_t> lastPick(members.size(), 0);
+    size_t bound = 2*members.size() - 1;
+    for (size_t pick = 1; pick <= 20*members.size(); ++pick) {
+        if (pick == 5*members.size())
+            table.DebugInsert(members.back());
+
+        // Gossip targets don't move the probe order
+        Member gossipTarget{};
+        ASSERT_TRUE(table.RandomTarget(gossipTarget, self));
+        EXPECT_FALSE(gossipTarget.Addr == self);
+        EXPECT_EQ(gossipTarget.Info.Status, MemberInfo::State::Alive);
+
+        Member target{};
+        ASSERT_TRUE(table.NextProbeTarget(target, self));
+        EXPECT_FALSE(target.Addr == self);
+        EXPECT_EQ(target.Info.Status, MemberInfo::State::Alive);
+
+        size_t i = target.Addr.Port - 80;
+        size_t since = i == members.size() - 1 ? 5*members.size() : 0;
+        EXPECT_LE(pick - std::max(lastPick[i], since), bound);
+        lastPick[i] = pick;
+    }
+
+    for (size_t i = 3; i < members.size(); ++i)
+        EXPECT_LE(20*members.size() - lastPick[i], bound);
+
+    MemberTable lonely;
+    lonely.DebugInsert(members[0]);
+    Member target{};
+    EXPECT_FALSE(lonely.NextProbeTarget(target, self));
+    EXPECT_FALSE(lonely.RandomTarget(target, self));
+}
+
+TEST(JSONWriter, MatchesDOM) {
+    for (const auto& member : list.GetList()) {
+        std::string out;
+        AppendJSON(out, member);
+        EXPECT_EQ(out, member.ToJSON().dump());
+    }
+
+    Member v6{MemberAddr{boost::asio::ip::address::from_string("2001:db8::ff00:42:8329"), 65535},
+              MemberInfo{MemberInfo::State::Suspicious, 4294967295u, TimeStamp{0}}};
+    std::string out;
+    AppendJSON(out, v6);
+    EXPECT_EQ(out, v6.ToJSON().dump());
+    EXPECT_LE(out.size(), MemberTableJSON::MaxSize);
+
+    MemberTable table;
+    MemberTableJSON tableJSON;
+    EXPECT_EQ(tableJSON.Dump(table), table.ToJSON().dump());
+
+    for (const auto& member : list.GetList())
+        table.DebugInsert(member);
+    EXPECT_EQ(tableJSON.Dump(table), table.ToJSON().dump());
+}
+
+TEST(JSONWriter, FragmentsFollowChanges) {
+    MemberTable table;
+    for (const auto& member : list.GetList())
+        table.DebugInsert(member);
+
+    MemberTableJSON tableJSON;
+    tableJSON.Dump(table);
+
+    Member changed = list.GetList()[3];
+    changed.Info.Incarnation += 1;
+    changed.Info.Status = MemberInfo::State::Dead;
+    ASSERT_TRUE(table.UpdateRecordIfNewer(changed));
+
+    Member added{MemberAddr{boost::asio::ip::address::from_string("10.1.2.3"), 7000},
+                 MemberInfo{MemberInfo::State::Alive, 1, TimeStamp{0}}};
+    table.UpdateRecordIfNewer(added);
+
+    EXPECT_EQ(tableJSON.Dump(table), table.ToJSON().dump());
+
+    // Appends to the end of what's already there
+    std::string out = "members=";
+    tableJSON.Append(out, table);
+    EXPECT_EQ(out, "members=" + table.ToJSON().dump());
+}
+
+TEST(MemberTable, Digests) {
+    const auto& members = list.GetList();
+
+    MemberTable forward;
+    MemberTable backward;
+    for (const auto& member : members)
+        forward.UpdateRecordIfNewer(member);
+    EXPECT_NE(forward.Digest(), backward.Digest());
+    for (auto it = members.rbegin(); it != members.rend(); ++it)
+        backward.UpdateRecordIfNewer(*it);
+
+    // Order doesn't matter, every level sums up to the root
+    EXPECT_EQ(forward.Digest(), backward.Digest());
+    for (size_t level = 0; level <= MemberTable::DigestDepth; level += 3) {
+        std::vector<uint64_t> digests;
+        forward.RangeDigests(level, digests);
+        EXPECT_EQ(digests.size(), size_t{1} << level);
+
+        uint64_t sum = 0;
+        for (auto digest : digests)
+            sum += digest;
+        EXPECT_EQ(sum, forward.Digest());
+    }
+
+    // Kept up to date by changes, only the changed range differs
+    Member changed = members[5];
+    changed.Info.Incarnation += 1;
+    forward.UpdateRecordIfNewer(changed);
+    EXPECT_NE(forward.Digest(), backward.Digest());
+
+    std::vector<uint64_t> forwardDigests;
+    std::vector<uint64_t> backwardDigests;
+    forward.RangeDigests(4, forwardDigests);
+    backward.RangeDigests(4, backwardDigests);
+    for (size_t range = 0; range < forwardDigests.size(); ++range) {
+        bool diverged = range == MemberTable::Range(changed.Addr, 4);
+        EXPECT_EQ(forwardDigests[range] != backwardDigests[range], diverged);
+    }
+
+    std::vector<bool> ranges(forwardDigests.size());
+    ranges[MemberTable::Range(changed.Addr, 4)] = true;
+    std::vector<Member> records;
+    forward.RangeRecords(4, ranges, records);
+    EXPECT_NE(std::find(records.begin(), records.end(), changed), records.end());
+
+    backward.UpdateRecordIfNewer(changed);
+    EXPECT_EQ(forward.Digest(), backward.Digest());
+
+    // Timestamps aren't compared
+    Member later = changed;
+    later.Info.LastUpdate.Time += 10;
+    MemberTable copy;
+    copy.UpdateRecordIfNewer(later);
+    MemberTable original;
+    original.UpdateRecordIfNewer(changed);
+    EXPECT_EQ(copy.Digest(), original.Digest());
+}